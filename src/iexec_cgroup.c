@@ -0,0 +1,158 @@
+#include "iexec_cgroup.h"
+#include "iexec_print.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int iexec_cgroup_env_enabled = 0;
+static char iexec_cgroup_env_cpus[24];
+static char iexec_cgroup_env_memory[24];
+
+// variables sized by the CPU count; IEXEC_CPUS is the generic one
+static const char *const iexec_cgroup_env_cpu_names[] = {
+    "IEXEC_CPUS", "GOMAXPROCS", "OMP_NUM_THREADS", "MALLOC_ARENA_MAX"};
+
+static int iexec_cgroup_read_file(const char *path, char *buf, size_t size) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return -1;
+  }
+  ssize_t len = read(fd, buf, size - 1);
+  close(fd);
+  if (len <= 0) {
+    return -1;
+  }
+  buf[len] = '\0';
+  if (buf[len - 1] == '\n') {
+    buf[len - 1] = '\0';
+  }
+  return 0;
+}
+
+static int iexec_cgroup_path(char *path, size_t size) {
+  char line[PATH_MAX];
+  FILE *fp = fopen("/proc/self/cgroup", "re");
+  if (fp == NULL) {
+    return -1;
+  }
+  int found = -1;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (strncmp(line, "0::", 3) != 0) {
+      continue;
+    }
+    line[strcspn(line, "\n")] = '\0';
+    if ((size_t)snprintf(path, size, "/sys/fs/cgroup%s", line + 3) < size) {
+      found = 0;
+    }
+    break;
+  }
+  fclose(fp);
+  return found;
+}
+
+int iexec_cgroup_read(const char *name, char *buf, size_t size) {
+  char dir[PATH_MAX];
+  char path[PATH_MAX];
+  if (iexec_cgroup_path(dir, sizeof(dir)) == -1) {
+    return -1;
+  }
+  if ((size_t)snprintf(path, sizeof(path), "%s/%s", dir, name) >=
+      sizeof(path)) {
+    return -1;
+  }
+  return iexec_cgroup_read_file(path, buf, size);
+}
+
+static long iexec_cgroup_quota_cpus(iexec_cpu_rounding_t rounding) {
+  char buf[64];
+  long long quota;
+  long long period;
+  if (iexec_cgroup_read("cpu.max", buf, sizeof(buf)) == -1) {
+    return -1;
+  }
+  if (sscanf(buf, "%lld %lld", &quota, &period) != 2 || quota <= 0 ||
+      period <= 0) {
+    // "max" means no quota
+    return -1;
+  }
+  long long cpus;
+  switch (rounding) {
+  case IEXEC_CPU_ROUNDING_FLOOR:
+    cpus = quota / period;
+    break;
+  case IEXEC_CPU_ROUNDING_NEAREST:
+    cpus = (quota + period / 2) / period;
+    break;
+  default:
+    cpus = (quota + period - 1) / period;
+    break;
+  }
+  if (cpus < 1) {
+    cpus = 1;
+  }
+  return (long)cpus;
+}
+
+static long iexec_cgroup_affinity_cpus(void) {
+  cpu_set_t set;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    return CPU_COUNT(&set);
+  }
+  return sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+long iexec_cgroup_cpus(iexec_cpu_rounding_t rounding) {
+  long cpus = iexec_cgroup_affinity_cpus();
+  long quota = iexec_cgroup_quota_cpus(rounding);
+  if (quota != -1 && (cpus < 1 || quota < cpus)) {
+    cpus = quota;
+  }
+  return cpus >= 1 ? cpus : -1;
+}
+
+void iexec_cgroup_env_configure(const iexec_option_t *ctx) {
+  if (!ctx->cgroup_env) {
+    return;
+  }
+  iexec_cgroup_env_enabled = 1;
+
+  long cpus = iexec_cgroup_cpus(ctx->cpu_rounding);
+  if (cpus != -1) {
+    snprintf(iexec_cgroup_env_cpus, sizeof(iexec_cgroup_env_cpus), "%ld", cpus);
+  }
+
+  char buf[64];
+  char *end;
+  if (iexec_cgroup_read("memory.max", buf, sizeof(buf)) == 0) {
+    unsigned long long bytes = strtoull(buf, &end, 10);
+    if (end != buf && *end == '\0' && bytes > 0) {
+      snprintf(iexec_cgroup_env_memory, sizeof(iexec_cgroup_env_memory),
+               "%llu", bytes);
+    }
+  }
+
+  iexec_printf(IEXEC_PRINT_LEVEL_INFORMATION,
+               "cgroup sizing: cpus=%s memory=%s\n",
+               iexec_cgroup_env_cpus[0] ? iexec_cgroup_env_cpus : "unknown",
+               iexec_cgroup_env_memory[0] ? iexec_cgroup_env_memory : "max");
+}
+
+void iexec_cgroup_env_put(void) {
+  if (!iexec_cgroup_env_enabled) {
+    return;
+  }
+  if (iexec_cgroup_env_cpus[0] != '\0') {
+    size_t count = sizeof(iexec_cgroup_env_cpu_names) /
+                   sizeof(iexec_cgroup_env_cpu_names[0]);
+    for (size_t i = 0; i < count; i++) {
+      setenv(iexec_cgroup_env_cpu_names[i], iexec_cgroup_env_cpus, 0);
+    }
+  }
+  if (iexec_cgroup_env_memory[0] != '\0') {
+    setenv("IEXEC_MEMORY_BYTES", iexec_cgroup_env_memory, 0);
+  }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "iexec.h"
+#include "iexec_option.h"
+#include <stddef.h>
+
+/**
+ * @brief Read a control file of the cgroup v2 group iexec belongs to
+ *
+ * The group is taken from the "0::" entry of /proc/self/cgroup and resolved
+ * below /sys/fs/cgroup. A trailing newline is stripped.
+ *
+ * @param name control file name, e.g. "pids.max"
+ * @param buf buffer for the file contents
+ * @param size buffer size
+ * @return 0 on success, -1 if there is no cgroup v2 group or file
+ */
+int iexec_cgroup_read(const char *name, char *buf, size_t size);
+
+/**
+ * @brief Number of CPUs iexec may use
+ *
+ * The cpu.max quota rounded by the given policy, capped by the CPU affinity
+ * mask.
+ *
+ * @param rounding rounding policy for a fractional quota
+ * @return CPU count, or -1 if unknown
+ */
+long iexec_cgroup_cpus(iexec_cpu_rounding_t rounding);
+
+/**
+ * @brief Derive child sizing variables from the cgroup v2 limits
+ *
+ * The CPU count is the cpu.max quota rounded by the configured policy and
+ * capped by the CPU affinity mask; the memory size is memory.max. Limits are
+ * read once, so respawned commands get the same values.
+ *
+ * @param ctx iexec_option_t context
+ */
+void iexec_cgroup_env_configure(const iexec_option_t *ctx);
+
+/**
+ * @brief Export the derived sizing variables in a spawned child
+ *
+ * Variables that are already set, either inherited or given as NAME=VALUE
+ * arguments, are kept.
+ */
+void iexec_cgroup_env_put(void);
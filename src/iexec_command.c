@@ -0,0 +1,87 @@
+#include "iexec_command.h"
+#include "iexec_cgroup.h"
+#include "iexec_forward.h"
+#include "iexec_harden.h"
+#include "iexec_journal.h"
+#include "iexec_process.h"
+#include "iexec_timeout.h"
+#include "iexec_watchdog.h"
+#include <signal.h>
+#include <string.h>
+
+static char **iexec_command_argv = NULL;
+static int iexec_command_cmdind = 0;
+static sigset_t iexec_command_sigmask;
+static sigset_t iexec_command_caught;
+
+void iexec_command_save_sigmask(void) {
+  sigprocmask(SIG_SETMASK, NULL, &iexec_command_sigmask);
+  sigemptyset(&iexec_command_caught);
+}
+
+void iexec_command_catch_signal(int signum) {
+  sigaddset(&iexec_command_caught, signum);
+}
+
+static void iexec_command_reset_signals(void) {
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = SIG_DFL;
+  sigemptyset(&action.sa_mask);
+  for (int signum = 1; signum < NSIG; signum++) {
+    if (sigismember(&iexec_command_caught, signum) == 1) {
+      sigaction(signum, &action, NULL);
+    }
+  }
+}
+
+void iexec_command_init(char **argv, int cmdind) {
+  iexec_command_argv = argv;
+  iexec_command_cmdind = cmdind;
+}
+
+static pid_t iexec_command_fork_exec(char **argv, int cmdind, int main,
+                                     iexec_command_prepare_t prepare,
+                                     void *arg) {
+  if (main) {
+    iexec_watchdog_prepare();
+  }
+  pid_t pid = iexec_try_fork();
+  if (pid != 0) {
+    if (main) {
+      iexec_watchdog_spawned(pid);
+    }
+    if (pid > 0) {
+      iexec_journal_record(IEXEC_JOURNAL_SPAWN, pid, 0, 0);
+    }
+    return pid;
+  }
+  iexec_journal_forked();
+  // a forwarded signal must not run iexec's handler, which signals the
+  // current main instance, in the child; the parent may have signals
+  // blocked while spawning (e.g. during reload)
+  iexec_command_reset_signals();
+  sigprocmask(SIG_SETMASK, &iexec_command_sigmask, NULL);
+  iexec_harden_undo();
+  iexec_put_envs(cmdind, argv);
+  iexec_cgroup_env_put();
+  if (main) {
+    iexec_forward_child();
+    iexec_watchdog_child();
+    iexec_timeout_child();
+  }
+  if (prepare != NULL) {
+    prepare(arg);
+  }
+  iexec_execvp(argv[cmdind], argv + cmdind);
+}
+
+pid_t iexec_command_spawn_argv(char **argv, int cmdind,
+                              iexec_command_prepare_t prepare, void *arg) {
+  return iexec_command_fork_exec(argv, cmdind, 0, prepare, arg);
+}
+
+pid_t iexec_command_spawn(iexec_command_prepare_t prepare, void *arg) {
+  return iexec_command_fork_exec(iexec_command_argv, iexec_command_cmdind, 1,
+                                 prepare, arg);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "iexec.h"
+#include <sys/types.h>
+
+/**
+ * @brief Child-side hook run between fork and exec
+ *
+ * @param arg Hook argument passed to iexec_command_spawn
+ */
+typedef void (*iexec_command_prepare_t)(void *arg);
+
+/**
+ * @brief Remember the signal mask that spawned commands start with
+ *
+ * Must be called before the wait loop blocks any signal.
+ */
+void iexec_command_save_sigmask(void);
+
+/**
+ * @brief Record a signal that iexec catches with its own handler
+ *
+ * Spawned commands reset recorded signals to SIG_DFL before they unblock the
+ * saved signal mask, so iexec's handlers never run between fork and exec.
+ *
+ * @param signum caught signal
+ */
+void iexec_command_catch_signal(int signum);
+
+/**
+ * @brief Remember the command so it can be spawned more than once
+ *
+ * @param argv Argument vector (leading NAME=value assignments included)
+ * @param cmdind Index of the command in argv
+ */
+void iexec_command_init(char **argv, int cmdind);
+
+/**
+ * @brief Fork and exec the remembered command as a main instance
+ *
+ * Main instances also get the watchdog heartbeat fd.
+ *
+ * @param prepare Optional child-side hook run before exec
+ * @param arg Hook argument
+ * @return child pid, or -1 if fork failed
+ */
+pid_t iexec_command_spawn(iexec_command_prepare_t prepare, void *arg);
+
+/**
+ * @brief Fork and exec another command with the same child setup
+ *
+ * The command is not a main instance and is not watched by the watchdog.
+ *
+ * @param argv Argument vector (leading NAME=value assignments included)
+ * @param cmdind Index of the command in argv
+ * @param prepare Optional child-side hook run before exec
+ * @param arg Hook argument
+ * @return child pid, or -1 if fork failed
+ */
+pid_t iexec_command_spawn_argv(char **argv, int cmdind,
+                              iexec_command_prepare_t prepare, void *arg);
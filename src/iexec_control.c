@@ -0,0 +1,608 @@
+#include "iexec_control.h"
+#include "iexec_command.h"
+#include "iexec_option.h"
+#include "iexec_print.h"
+#include "iexec_process.h"
+#include "iexec_proctree.h"
+#include "iexec_timeout.h"
+#include "iexec_watchdog.h"
+#include "iexec_wait.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/sockios.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define IEXEC_CONTROL_MAGIC 0x69657863u
+#define IEXEC_CONTROL_MAX_ARGS 4096
+#define IEXEC_CONTROL_MAX_PAYLOAD 65536
+#define IEXEC_CONTROL_MAX_SESSIONS 16
+#define IEXEC_CONTROL_MAX_PENDING 4
+#define IEXEC_CONTROL_STDIO_FDS 3
+#define IEXEC_CONTROL_MAX_STATS 4096
+
+enum {
+  IEXEC_CONTROL_REQUEST_ATTACH = 1,
+  IEXEC_CONTROL_REQUEST_SIGNAL,
+  IEXEC_CONTROL_REQUEST_STATS,
+};
+
+enum {
+  IEXEC_CONTROL_REPLY_PID = 1,
+  IEXEC_CONTROL_REPLY_STATUS,
+  IEXEC_CONTROL_REPLY_ERROR,
+  IEXEC_CONTROL_REPLY_TEXT,
+};
+
+typedef struct iexec_control_request {
+  uint32_t magic;
+  uint32_t type;
+  uint32_t value; /* argc for ATTACH, signal number for SIGNAL */
+  uint32_t size;
+} iexec_control_request_t;
+
+typedef struct iexec_control_reply {
+  uint32_t magic;
+  uint32_t type;
+  int32_t value;
+} iexec_control_reply_t;
+
+/* a connection whose request has not fully arrived yet */
+typedef struct iexec_control_pending {
+  int fd; /* -1 when free */
+  uid_t uid;
+  unsigned long seq;
+  size_t received;
+  int count;
+  int fds[IEXEC_CONTROL_STDIO_FDS];
+  iexec_control_request_t request;
+} iexec_control_pending_t;
+
+typedef struct iexec_control_session {
+  pid_t pid;
+  int fd;
+} iexec_control_session_t;
+
+static iexec_control_session_t
+    iexec_control_sessions[IEXEC_CONTROL_MAX_SESSIONS];
+static int iexec_control_session_count = 0;
+static iexec_control_pending_t
+    iexec_control_pending[IEXEC_CONTROL_MAX_PENDING];
+static unsigned long iexec_control_accepted = 0;
+static volatile sig_atomic_t iexec_control_client_fd = -1;
+
+static void iexec_control_set_socket_path(struct sockaddr_un *addr,
+                                          const char *path) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path)) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "control socket path too long: %s\n",
+                 path);
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  strcpy(addr->sun_path, path);
+}
+
+static void iexec_control_reply(int fd, uint32_t type, int32_t value) {
+  iexec_control_reply_t reply;
+  reply.magic = IEXEC_CONTROL_MAGIC;
+  reply.type = type;
+  reply.value = value;
+  if (send(fd, &reply, sizeof(reply), MSG_NOSIGNAL) != sizeof(reply)) {
+    iexec_printf(IEXEC_PRINT_LEVEL_INFORMATION, "control reply: %s\n",
+                 iexec_strerror(iexec_errno()));
+  }
+}
+
+static void iexec_control_prepare_child(void *arg) {
+  const int *fds = arg;
+  for (int i = 0; i < IEXEC_CONTROL_STDIO_FDS; i++) {
+    int ret = fds[i] == i ? fcntl(i, F_SETFD, 0) : dup2(fds[i], i);
+    if (ret == -1) {
+      iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "dup2: %s\n",
+                   iexec_strerror(iexec_errno()));
+      iexec_exit(IEXEC_EXIT_FAILURE);
+    }
+  }
+}
+
+/* returns 1 once the request header is complete, 0 to wait for more */
+static int iexec_control_receive(iexec_control_pending_t *pending) {
+  union {
+    char buf[CMSG_SPACE(sizeof(int) * IEXEC_CONTROL_STDIO_FDS)];
+    struct cmsghdr align;
+  } control;
+  struct iovec iov;
+  struct msghdr msg;
+
+  iov.iov_base = (char *)&pending->request + pending->received;
+  iov.iov_len = sizeof(pending->request) - pending->received;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  ssize_t len = recvmsg(pending->fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+  if (len == -1 && (errno == EAGAIN || errno == EINTR)) {
+    return 0;
+  }
+  if (len <= 0) {
+    return -EPROTO;
+  }
+  pending->received += (size_t)len;
+
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+    int n = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+    for (int i = 0; i < n; i++) {
+      int fd;
+      memcpy(&fd, CMSG_DATA(cmsg) + sizeof(int) * (size_t)i, sizeof(int));
+      if (pending->count < IEXEC_CONTROL_STDIO_FDS) {
+        pending->fds[pending->count++] = fd;
+      } else {
+        close(fd);
+      }
+    }
+  }
+  if (msg.msg_flags & MSG_CTRUNC) {
+    return -EPROTO;
+  }
+  return pending->received == sizeof(pending->request);
+}
+
+static int iexec_control_validate(const iexec_control_pending_t *pending) {
+  const iexec_control_request_t *request = &pending->request;
+  if (request->magic != IEXEC_CONTROL_MAGIC) {
+    return -EPROTO;
+  }
+  if (request->type == IEXEC_CONTROL_REQUEST_STATS && pending->count == 0 &&
+      request->value == 0 && request->size == 0) {
+    return 0;
+  }
+  if (request->type != IEXEC_CONTROL_REQUEST_ATTACH ||
+      pending->count != IEXEC_CONTROL_STDIO_FDS || request->value == 0 ||
+      request->value > IEXEC_CONTROL_MAX_ARGS || request->size == 0 ||
+      request->size > IEXEC_CONTROL_MAX_PAYLOAD) {
+    return -EINVAL;
+  }
+  return 0;
+}
+
+/* returns 1 once the whole payload is queued, 0 to wait for more */
+static int iexec_control_payload_ready(const iexec_control_pending_t *pending) {
+  int avail;
+  if (ioctl(pending->fd, SIOCINQ, &avail) == -1) {
+    return -EPROTO;
+  }
+  if ((size_t)avail >= pending->request.size) {
+    return 1;
+  }
+  // a client that hung up mid-request would keep the socket readable
+  struct pollfd pfd;
+  pfd.fd = pending->fd;
+  pfd.events = POLLRDHUP;
+  pfd.revents = 0;
+  if (poll(&pfd, 1, 0) == -1 || (pfd.revents & (POLLRDHUP | POLLHUP)) != 0) {
+    return -EPROTO;
+  }
+  return 0;
+}
+
+// requests are served one at a time, so the buffers are allocated up front
+static char iexec_control_payload[IEXEC_CONTROL_MAX_PAYLOAD + 1];
+static char *iexec_control_argv[IEXEC_CONTROL_MAX_ARGS + 1];
+
+static int iexec_control_spawn(int conn, const iexec_control_request_t *request,
+                               int *fds) {
+  char *payload = iexec_control_payload;
+  char **argv = iexec_control_argv;
+  // the payload is queued in full, so this does not block
+  if (recv(conn, payload, request->size, MSG_DONTWAIT) !=
+      (ssize_t)request->size) {
+    return -EPROTO;
+  }
+  payload[request->size] = '\0';
+
+  char *p = payload;
+  char *end = payload + request->size;
+  int argc = 0;
+  while (p < end && argc < (int)request->value) {
+    argv[argc++] = p;
+    p += strlen(p) + 1;
+  }
+  argv[argc] = NULL;
+  int cmdind = iexec_parse_command_index(argc, argv);
+  if (argc != (int)request->value || p != end || cmdind == argc) {
+    return -EINVAL;
+  }
+
+  pid_t pid =
+      iexec_command_spawn_argv(argv, cmdind, iexec_control_prepare_child, fds);
+  return pid == -1 ? -EAGAIN : pid;
+}
+
+static void iexec_control_send_stats(int conn) {
+  char text[IEXEC_CONTROL_MAX_STATS];
+  size_t len = iexec_proctree_format_stats(text, sizeof(text));
+  len += iexec_watchdog_format_stats(text + len, sizeof(text) - len);
+  len += iexec_timeout_format_stats(text + len, sizeof(text) - len);
+  iexec_control_reply(conn, IEXEC_CONTROL_REPLY_TEXT, (int32_t)len);
+  send(conn, text, len, MSG_NOSIGNAL);
+}
+
+static void iexec_control_session_input(int fd, void *arg) {
+  iexec_control_request_t request;
+  (void)arg;
+  for (int i = 0; i < iexec_control_session_count; i++) {
+    iexec_control_session_t *session = &iexec_control_sessions[i];
+    if (session->fd != fd) {
+      continue;
+    }
+    ssize_t len = recv(fd, &request, sizeof(request), MSG_DONTWAIT);
+    if (len == -1 && (errno == EAGAIN || errno == EINTR)) {
+      return;
+    }
+    if (len == sizeof(request) && request.magic == IEXEC_CONTROL_MAGIC &&
+        request.type == IEXEC_CONTROL_REQUEST_SIGNAL && request.value > 0 &&
+        request.value < NSIG) {
+      kill(session->pid, (int)request.value);
+      return;
+    }
+    // the client went away: hang up on the command like a closed terminal
+    iexec_printf(IEXEC_PRINT_LEVEL_INFORMATION,
+                 "control: client of pid %d detached\n", session->pid);
+    kill(session->pid, SIGHUP);
+    iexec_wait_remove_fd(fd);
+    close(fd);
+    session->fd = -1;
+    return;
+  }
+}
+
+static void iexec_control_drop(iexec_control_pending_t *pending) {
+  for (int i = 0; i < pending->count; i++) {
+    close(pending->fds[i]);
+  }
+  iexec_wait_remove_fd(pending->fd);
+  close(pending->fd);
+  pending->fd = -1;
+}
+
+static void iexec_control_reject(iexec_control_pending_t *pending, int error) {
+  iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "control request rejected: %s\n",
+               iexec_strerror(error));
+  iexec_control_reply(pending->fd, IEXEC_CONTROL_REPLY_ERROR, error);
+  iexec_control_drop(pending);
+}
+
+static void iexec_control_serve(iexec_control_pending_t *pending) {
+  int conn = pending->fd;
+  if (pending->request.type == IEXEC_CONTROL_REQUEST_STATS) {
+    iexec_control_send_stats(conn);
+    iexec_control_drop(pending);
+    return;
+  }
+  if (iexec_control_session_count == IEXEC_CONTROL_MAX_SESSIONS) {
+    iexec_control_reject(pending, EAGAIN);
+    return;
+  }
+  int ret = iexec_control_spawn(conn, &pending->request, pending->fds);
+  if (ret < 0) {
+    iexec_control_reject(pending, -ret);
+    return;
+  }
+  iexec_printf(IEXEC_PRINT_LEVEL_INFORMATION,
+               "control: attached pid %d for uid %ld\n", ret,
+               (long)pending->uid);
+  iexec_control_reply(conn, IEXEC_CONTROL_REPLY_PID, ret);
+  // the connection becomes a session: keep the socket, not the request
+  for (int i = 0; i < pending->count; i++) {
+    close(pending->fds[i]);
+  }
+  pending->fd = -1;
+  iexec_wait_remove_fd(conn);
+  iexec_control_sessions[iexec_control_session_count].pid = ret;
+  iexec_control_sessions[iexec_control_session_count].fd = conn;
+  iexec_control_session_count++;
+  // cannot fail: the pending request's entry was removed just above
+  iexec_wait_add_fd(conn, iexec_control_session_input, NULL);
+}
+
+static void iexec_control_pending_input(int fd, void *arg) {
+  iexec_control_pending_t *pending = arg;
+  (void)fd;
+  int ret = 1;
+  if (pending->received < sizeof(pending->request)) {
+    ret = iexec_control_receive(pending);
+    if (ret == 1) {
+      ret = iexec_control_validate(pending);
+      ret = ret == 0 ? 1 : ret;
+    }
+  }
+  if (ret == 1 && pending->request.type == IEXEC_CONTROL_REQUEST_ATTACH) {
+    ret = iexec_control_payload_ready(pending);
+  }
+  if (ret < 0) {
+    iexec_control_reject(pending, -ret);
+  } else if (ret == 1) {
+    iexec_control_serve(pending);
+  }
+}
+
+static iexec_control_pending_t *iexec_control_pending_slot(void) {
+  iexec_control_pending_t *oldest = &iexec_control_pending[0];
+  for (int i = 0; i < IEXEC_CONTROL_MAX_PENDING; i++) {
+    iexec_control_pending_t *pending = &iexec_control_pending[i];
+    if (pending->fd == -1) {
+      return pending;
+    }
+    if (pending->seq < oldest->seq) {
+      oldest = pending;
+    }
+  }
+  // a client that never completes its request only holds a slot until
+  // newer clients need it
+  iexec_control_reject(oldest, ETIMEDOUT);
+  return oldest;
+}
+
+static void iexec_control_accept(int fd, void *arg) {
+  struct ucred cred;
+  socklen_t cred_len = sizeof(cred);
+  (void)arg;
+  int conn = accept4(fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+  if (conn == -1) {
+    if (errno != EAGAIN && errno != EINTR && errno != ECONNABORTED) {
+      iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "accept: %s\n",
+                   iexec_strerror(iexec_errno()));
+    }
+    return;
+  }
+  if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) == -1 ||
+      (cred.uid != 0 && cred.uid != getuid())) {
+    iexec_control_reply(conn, IEXEC_CONTROL_REPLY_ERROR, EPERM);
+    close(conn);
+    return;
+  }
+  iexec_control_pending_t *pending = iexec_control_pending_slot();
+  memset(pending, 0, sizeof(*pending));
+  pending->fd = conn;
+  pending->uid = cred.uid;
+  pending->seq = ++iexec_control_accepted;
+  if (iexec_wait_add_fd(conn, iexec_control_pending_input, pending) == -1) {
+    iexec_control_reject(pending, EAGAIN);
+  }
+}
+
+void iexec_control_listen(const char *path) {
+  struct sockaddr_un addr;
+  struct stat st;
+
+  if (path == NULL) {
+    return;
+  }
+  iexec_control_set_socket_path(&addr, path);
+  if (lstat(path, &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      iexec_printf(IEXEC_PRINT_LEVEL_FATAL,
+                   "control socket path exists and is not a socket: %s\n",
+                   path);
+      iexec_exit(IEXEC_EXIT_FAILURE);
+    }
+    // a socket left behind by an earlier run
+    unlink(path);
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (fd == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "socket: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  mode_t mask = umask(077);
+  int ret = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+  umask(mask);
+  if (ret == -1 || listen(fd, IEXEC_CONTROL_MAX_SESSIONS) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "control socket %s: %s\n", path,
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  for (int i = 0; i < IEXEC_CONTROL_MAX_PENDING; i++) {
+    iexec_control_pending[i].fd = -1;
+  }
+  if (iexec_wait_add_fd(fd, iexec_control_accept, NULL) == -1) {
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+}
+
+void iexec_control_reaped(pid_t pid, int status) {
+  for (int i = 0; i < iexec_control_session_count; i++) {
+    if (iexec_control_sessions[i].pid == pid) {
+      int fd = iexec_control_sessions[i].fd;
+      if (fd != -1) {
+        iexec_control_reply(fd, IEXEC_CONTROL_REPLY_STATUS, status);
+        iexec_wait_remove_fd(fd);
+        close(fd);
+      }
+      iexec_control_sessions[i] =
+          iexec_control_sessions[--iexec_control_session_count];
+      return;
+    }
+  }
+}
+
+static void iexec_control_forward_signal(int signum) {
+  int fd = (int)iexec_control_client_fd;
+  if (fd != -1) {
+    // pids are not comparable across PID namespaces, so ask the server
+    int saved_errno = errno;
+    iexec_control_request_t request;
+    request.magic = IEXEC_CONTROL_MAGIC;
+    request.type = IEXEC_CONTROL_REQUEST_SIGNAL;
+    request.value = (uint32_t)signum;
+    request.size = 0;
+    send(fd, &request, sizeof(request), MSG_NOSIGNAL);
+    errno = saved_errno;
+  }
+}
+
+static void iexec_control_install_forwarders(void) {
+  static const int signums[] = {SIGTERM, SIGINT, SIGHUP, SIGQUIT};
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = iexec_control_forward_signal;
+  sigemptyset(&action.sa_mask);
+  for (size_t i = 0; i < sizeof(signums) / sizeof(signums[0]); i++) {
+    if (sigaction(signums[i], &action, NULL) == -1) {
+      iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "sigaction: %s\n",
+                   iexec_strerror(iexec_errno()));
+      iexec_exit(IEXEC_EXIT_FAILURE);
+    }
+  }
+}
+
+static void iexec_control_read_reply(int fd, iexec_control_reply_t *reply,
+                                     uint32_t type) {
+  ssize_t len;
+  do {
+    len = recv(fd, reply, sizeof(*reply), MSG_WAITALL);
+  } while (len == -1 && errno == EINTR);
+  if (len == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "control socket: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  if (len != sizeof(*reply) || reply->magic != IEXEC_CONTROL_MAGIC) {
+    iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "control connection closed\n");
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  if (reply->type == IEXEC_CONTROL_REPLY_ERROR) {
+    iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "control request rejected: %s\n",
+                 iexec_strerror(reply->value));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  if (reply->type != type) {
+    iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "unexpected control reply\n");
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+}
+
+static int iexec_control_connect(const char *path) {
+  struct sockaddr_un addr;
+  iexec_control_set_socket_path(&addr, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "control socket %s: %s\n", path,
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  return fd;
+}
+
+void iexec_control_attach(const char *path, int argc, char **argv) {
+  iexec_control_request_t request;
+  iexec_control_reply_t reply;
+
+  if (iexec_parse_command_index(argc, argv) == argc) {
+    iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "No command specified\n");
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  size_t size = 0;
+  for (int i = 0; i < argc; i++) {
+    size += strlen(argv[i]) + 1;
+  }
+  if (argc > IEXEC_CONTROL_MAX_ARGS || size > IEXEC_CONTROL_MAX_PAYLOAD) {
+    iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "Command line too long\n");
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  char *payload = malloc(size);
+  if (payload == NULL) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "malloc: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  char *p = payload;
+  for (int i = 0; i < argc; i++) {
+    size_t len = strlen(argv[i]) + 1;
+    memcpy(p, argv[i], len);
+    p += len;
+  }
+
+  int fd = iexec_control_connect(path);
+
+  int fds[IEXEC_CONTROL_STDIO_FDS] = {STDIN_FILENO, STDOUT_FILENO,
+                                      STDERR_FILENO};
+  union {
+    char buf[CMSG_SPACE(sizeof(fds))];
+    struct cmsghdr align;
+  } control;
+  struct iovec iov[2];
+  struct msghdr msg;
+  request.magic = IEXEC_CONTROL_MAGIC;
+  request.type = IEXEC_CONTROL_REQUEST_ATTACH;
+  request.value = (uint32_t)argc;
+  request.size = (uint32_t)size;
+  iov[0].iov_base = &request;
+  iov[0].iov_len = sizeof(request);
+  iov[1].iov_base = payload;
+  iov[1].iov_len = size;
+  memset(&msg, 0, sizeof(msg));
+  memset(&control, 0, sizeof(control));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  if (sendmsg(fd, &msg, MSG_NOSIGNAL) != (ssize_t)(sizeof(request) + size)) {
+    iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "control socket %s: %s\n", path,
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  free(payload);
+
+  iexec_control_read_reply(fd, &reply, IEXEC_CONTROL_REPLY_PID);
+  iexec_control_client_fd = fd;
+  iexec_control_install_forwarders();
+  iexec_control_read_reply(fd, &reply, IEXEC_CONTROL_REPLY_STATUS);
+  iexec_exit_from_wait_status(reply.value);
+}
+
+void iexec_control_stats(const char *path) {
+  iexec_control_request_t request;
+  iexec_control_reply_t reply;
+  char text[IEXEC_CONTROL_MAX_STATS];
+
+  int fd = iexec_control_connect(path);
+  request.magic = IEXEC_CONTROL_MAGIC;
+  request.type = IEXEC_CONTROL_REQUEST_STATS;
+  request.value = 0;
+  request.size = 0;
+  if (send(fd, &request, sizeof(request), MSG_NOSIGNAL) != sizeof(request)) {
+    iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "control socket %s: %s\n", path,
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  iexec_control_read_reply(fd, &reply, IEXEC_CONTROL_REPLY_TEXT);
+  if (reply.value < 0 || reply.value > IEXEC_CONTROL_MAX_STATS ||
+      recv(fd, text, (size_t)reply.value, MSG_WAITALL) != reply.value) {
+    iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "control connection closed\n");
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  fwrite(text, 1, (size_t)reply.value, stdout);
+  iexec_exit(IEXEC_EXIT_SUCCESS);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "iexec.h"
+#include <sys/types.h>
+
+/**
+ * @brief Listen on a Unix control socket from the wait loop
+ *
+ * @param path socket path, or NULL to disable the control socket
+ */
+void iexec_control_listen(const char *path);
+
+/**
+ * @brief Report a reaped child so an attached client can get its status
+ *
+ * @param pid reaped pid
+ * @param status wait status
+ */
+void iexec_control_reaped(pid_t pid, int status);
+
+/**
+ * @brief Run a command as a child of the iexec serving the control socket
+ *
+ * Standard input, output, and error are passed to the server, which forks the
+ * command, reaps it, and reports its wait status back.
+ *
+ * @param path control socket path
+ * @param argc Argument count (leading NAME=value assignments included)
+ * @param argv Argument vector (leading NAME=value assignments included)
+ */
+void iexec_control_attach(const char *path, int argc, char **argv)
+    __attribute__((noreturn));
+
+/**
+ * @brief Print the metrics of the iexec serving the control socket
+ *
+ * @param path control socket path
+ */
+void iexec_control_stats(const char *path) __attribute__((noreturn));
@@ -0,0 +1,227 @@
+#include "iexec_journal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *iexec_events_type_name(uint16_t type) {
+  switch (type) {
+  case IEXEC_JOURNAL_START:
+    return "start";
+  case IEXEC_JOURNAL_SPAWN:
+    return "spawn";
+  case IEXEC_JOURNAL_EXEC_START:
+    return "exec";
+  case IEXEC_JOURNAL_EXEC_FAIL:
+    return "exec-fail";
+  case IEXEC_JOURNAL_REAP:
+    return "reap";
+  case IEXEC_JOURNAL_SIGNAL:
+    return "signal";
+  case IEXEC_JOURNAL_FORWARD:
+    return "forward";
+  case IEXEC_JOURNAL_RELOAD:
+    return "reload";
+  case IEXEC_JOURNAL_RELOAD_FAIL:
+    return "reload-fail";
+  case IEXEC_JOURNAL_EXIT:
+    return "exit";
+  case IEXEC_JOURNAL_WATCHDOG:
+    return "watchdog";
+  case IEXEC_JOURNAL_TIMEOUT:
+    return "timeout";
+  default:
+    return "unknown";
+  }
+}
+
+static const char *iexec_events_signal_name(int signum) {
+  static char buf[16];
+  const char *name = sigabbrev_np(signum);
+  if (name != NULL) {
+    return name;
+  }
+  if (SIGRTMIN <= signum && signum <= SIGRTMAX) {
+    snprintf(buf, sizeof(buf), "RTMIN+%d", signum - SIGRTMIN);
+    return buf;
+  }
+  return "?";
+}
+
+static void iexec_events_print(const iexec_journal_record_t *record) {
+  printf("%" PRIu64 " %" PRIu64 ".%09" PRIu64 " %s", record->seq,
+         record->time_ns / 1000000000u, record->time_ns % 1000000000u,
+         iexec_events_type_name(record->type));
+  switch (record->type) {
+  case IEXEC_JOURNAL_START:
+  case IEXEC_JOURNAL_SPAWN:
+  case IEXEC_JOURNAL_EXEC_START:
+  case IEXEC_JOURNAL_RELOAD_FAIL:
+    printf(" pid=%" PRId32, record->pid);
+    break;
+  case IEXEC_JOURNAL_EXEC_FAIL:
+    printf(" pid=%" PRId32 " error=%s", record->pid,
+           strerror(record->arg0));
+    break;
+  case IEXEC_JOURNAL_REAP:
+    printf(" pid=%" PRId32 " comm=%.*s", record->pid,
+           (int)sizeof(record->comm), record->comm);
+    if (WIFEXITED(record->arg0)) {
+      printf(" exited=%d", WEXITSTATUS(record->arg0));
+    } else if (WIFSIGNALED(record->arg0)) {
+      printf(" signaled=%s", iexec_events_signal_name(WTERMSIG(record->arg0)));
+    } else {
+      printf(" status=0x%" PRIx32, (uint32_t)record->arg0);
+    }
+    printf(" main=%" PRId32, record->arg1);
+    break;
+  case IEXEC_JOURNAL_SIGNAL:
+    printf(" signal=%s", iexec_events_signal_name(record->arg0));
+    break;
+  case IEXEC_JOURNAL_FORWARD:
+    printf(" pid=%" PRId32 " signal=%s result=%" PRId32, record->pid,
+           iexec_events_signal_name(record->arg0), record->arg1);
+    break;
+  case IEXEC_JOURNAL_RELOAD:
+    printf(" pid=%" PRId32 " old=%" PRId32, record->pid, record->arg0);
+    break;
+  case IEXEC_JOURNAL_EXIT:
+    printf(" status=%" PRId32, record->arg0);
+    break;
+  case IEXEC_JOURNAL_WATCHDOG:
+    printf(" pid=%" PRId32 " signal=%s missed=%" PRId32, record->pid,
+           iexec_events_signal_name(record->arg0), record->arg1);
+    break;
+  case IEXEC_JOURNAL_TIMEOUT:
+    printf(" pid=%" PRId32 " signal=%s tree=%" PRId32, record->pid,
+           iexec_events_signal_name(record->arg0), record->arg1);
+    break;
+  default:
+    printf(" pid=%" PRId32 " arg0=%" PRId32 " arg1=%" PRId32, record->pid,
+           record->arg0, record->arg1);
+    break;
+  }
+  printf("\n");
+}
+
+static uint64_t iexec_events_dump(const iexec_journal_header_t *header,
+                                  uint64_t next) {
+  const iexec_journal_record_t *records =
+      (const iexec_journal_record_t *)(header + 1);
+  uint64_t head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+  if (head >= header->capacity && next <= head - header->capacity) {
+    uint64_t first = head - header->capacity + 1;
+    if (next > 1) {
+      printf("# %" PRIu64 " events lost\n", first - next);
+    }
+    next = first;
+  }
+  for (; next <= head; next++) {
+    const iexec_journal_record_t *slot =
+        &records[(next - 1) % header->capacity];
+    iexec_journal_record_t record;
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != next) {
+      // still being written, or already overwritten by a newer event
+      continue;
+    }
+    memcpy(&record, slot, sizeof(record));
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != next) {
+      continue;
+    }
+    record.seq = next;
+    iexec_events_print(&record);
+  }
+  fflush(stdout);
+  return next;
+}
+
+static void iexec_events_print_usage(FILE *stream) {
+  fprintf(stream, "Usage: %s [OPTION]... JOURNAL\n", program_invocation_name);
+  fprintf(stream, "Decode an iexec --journal file\n");
+  fprintf(stream, "\n");
+  fprintf(stream, "Options:\n");
+  fprintf(stream, "  -f, --follow                  keep printing new events\n");
+  fprintf(stream, "  -V, --version                 display version and exit\n");
+  fprintf(stream,
+          "  -h, --help                    display this help and exit\n");
+}
+
+int main(int argc, char **argv) {
+  int follow = 0;
+  int opt;
+  static struct option long_options[] = {{"follow", no_argument, NULL, 'f'},
+                                         {"version", no_argument, NULL, 'V'},
+                                         {"help", no_argument, NULL, 'h'},
+                                         {NULL, 0, NULL, 0}};
+  while ((opt = getopt_long(argc, argv, "fVh", long_options, NULL)) != -1) {
+    switch (opt) {
+    case 'f':
+      follow = 1;
+      break;
+    case 'V':
+      printf("%s\n", PACKAGE_STRING);
+      return EXIT_SUCCESS;
+    case 'h':
+      iexec_events_print_usage(stdout);
+      return EXIT_SUCCESS;
+    default:
+      fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (optind + 1 != argc) {
+    iexec_events_print_usage(stderr);
+    return EXIT_FAILURE;
+  }
+
+  const char *path = argv[optind];
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+    return EXIT_FAILURE;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    fprintf(stderr, "fstat %s: %s\n", path, strerror(errno));
+    return EXIT_FAILURE;
+  }
+  if ((size_t)st.st_size < sizeof(iexec_journal_header_t)) {
+    fprintf(stderr, "%s: not an iexec journal\n", path);
+    return EXIT_FAILURE;
+  }
+  void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "mmap %s: %s\n", path, strerror(errno));
+    return EXIT_FAILURE;
+  }
+  close(fd);
+
+  const iexec_journal_header_t *header = map;
+  if (memcmp(header->magic, IEXEC_JOURNAL_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != IEXEC_JOURNAL_VERSION ||
+      header->record_size != sizeof(iexec_journal_record_t) ||
+      header->capacity == 0 ||
+      (size_t)st.st_size != sizeof(iexec_journal_header_t) +
+                                sizeof(iexec_journal_record_t) *
+                                    (size_t)header->capacity) {
+    fprintf(stderr, "%s: not an iexec journal\n", path);
+    return EXIT_FAILURE;
+  }
+
+  uint64_t next = iexec_events_dump(header, 1);
+  while (follow) {
+    struct timespec interval = {0, 100000000};
+    nanosleep(&interval, NULL);
+    next = iexec_events_dump(header, next);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+#include "iexec_forward.h"
+#include "iexec_command.h"
+#include "iexec_journal.h"
+#include "iexec_print.h"
+#include "iexec_process.h"
+#include "iexec_syscall.h"
+#include "iexec_trace.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+static const int iexec_forward_default_signals[] = {SIGTERM, SIGINT, SIGHUP,
+                                                    SIGQUIT};
+
+/* never caught: synchronous faults, job control and iexec's own limits */
+static const int iexec_forward_excluded_signals[] = {
+    SIGKILL, SIGSTOP, SIGCHLD, SIGSEGV, SIGBUS, SIGILL, SIGFPE,  SIGABRT,
+    SIGTRAP, SIGSYS,  SIGPIPE, SIGTSTP, SIGTTIN, SIGTTOU, SIGXCPU, SIGXFSZ};
+
+#define IEXEC_FORWARD_COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+static iexec_forward_mode_t iexec_forward_mode = IEXEC_FORWARD_MODE_CHILD;
+static sigset_t iexec_forward_set;
+static int iexec_forward_rewrite[NSIG];
+static volatile sig_atomic_t iexec_forward_pid = -1;
+/* the main child was reaped, but its process group lives on */
+static volatile sig_atomic_t iexec_forward_group_only = 0;
+
+int iexec_forward_catchable(int signum) {
+  for (size_t i = 0; i < IEXEC_FORWARD_COUNT(iexec_forward_excluded_signals);
+       i++) {
+    if (iexec_forward_excluded_signals[i] == signum) {
+      return 0;
+    }
+  }
+  // glibc reserves the signals between the standard ones and SIGRTMIN
+  return signum < 32 || (SIGRTMIN <= signum && signum <= SIGRTMAX);
+}
+
+void iexec_forward_configure(const iexec_option_t *ctx) {
+  iexec_forward_mode = ctx->forward;
+  sigemptyset(&iexec_forward_set);
+  for (int signum = 1; signum < NSIG; signum++) {
+    iexec_forward_rewrite[signum] = ctx->signal_rewrite[signum];
+    if (!iexec_forward_catchable(signum) || signum == ctx->reload_signal) {
+      continue;
+    }
+    if (ctx->forward_all || ctx->signal_rewrite[signum] != signum) {
+      sigaddset(&iexec_forward_set, signum);
+    }
+  }
+  for (size_t i = 0; i < IEXEC_FORWARD_COUNT(iexec_forward_default_signals);
+       i++) {
+    int signum = iexec_forward_default_signals[i];
+    if (signum != ctx->reload_signal) {
+      sigaddset(&iexec_forward_set, signum);
+    }
+  }
+}
+
+int iexec_forward_kill(pid_t pid, int signum) {
+  if (iexec_forward_mode != IEXEC_FORWARD_MODE_CHILD) {
+    int ret = iexec_kill(-pid, signum);
+    if (ret == 0 || errno != ESRCH) {
+      return ret;
+    }
+    // the child has not created its own group yet
+  }
+  return iexec_kill(pid, signum);
+}
+
+static int iexec_forward_send(pid_t pid, int signum, const siginfo_t *info) {
+  if (iexec_forward_group_only) {
+    // the pid may be reused once the group is gone, so never fall back to it
+    int ret = iexec_kill(-pid, signum);
+    if (ret == -1 && errno == ESRCH) {
+      iexec_forward_pid = -1;
+    }
+    return ret;
+  }
+  // a group cannot be sent a payload, so it is kept in child mode only
+  if (iexec_forward_mode == IEXEC_FORWARD_MODE_CHILD &&
+      info->si_code == SI_QUEUE) {
+    return iexec_sigqueue(pid, signum, info->si_value);
+  }
+  return iexec_forward_kill(pid, signum);
+}
+
+static void iexec_forward_handler(int signum, siginfo_t *info, void *context) {
+  (void)context;
+  int saved_errno = errno;
+  pid_t pid = (pid_t)iexec_forward_pid;
+  int signum_out = iexec_forward_rewrite[signum];
+  iexec_journal_record(IEXEC_JOURNAL_SIGNAL, 0, signum, 0);
+  if (pid > 0 && signum_out != 0) {
+    pid_t target = iexec_forward_mode == IEXEC_FORWARD_MODE_CHILD ? pid : -pid;
+    int ret = iexec_forward_send(pid, signum_out, info);
+    IEXEC_TRACE4(forward, signum, signum_out, target, ret);
+    iexec_journal_record(IEXEC_JOURNAL_FORWARD, target, signum_out, ret);
+  }
+  errno = saved_errno;
+}
+
+void iexec_forward_child(void) {
+  if (iexec_forward_mode == IEXEC_FORWARD_MODE_SESSION) {
+    if (setsid() == -1) {
+      iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "setsid: %s\n",
+                   iexec_strerror(iexec_errno()));
+      iexec_exit(IEXEC_EXIT_FAILURE);
+    }
+    return;
+  }
+  if (iexec_forward_mode != IEXEC_FORWARD_MODE_GROUP) {
+    return;
+  }
+  int foreground =
+      isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp();
+  if (setpgid(0, 0) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "setpgid: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  if (foreground) {
+    // a background group asking for the terminal gets SIGTTOU
+    sigset_t mask;
+    sigset_t mask_saved;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTTOU);
+    sigprocmask(SIG_BLOCK, &mask, &mask_saved);
+    if (tcsetpgrp(STDIN_FILENO, getpgrp()) == -1) {
+      iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "Warning: tcsetpgrp: %s\n",
+                   iexec_strerror(iexec_errno()));
+    }
+    sigprocmask(SIG_SETMASK, &mask_saved, NULL);
+  }
+}
+
+void iexec_forward_start(pid_t pid) {
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = iexec_forward_handler;
+  action.sa_flags = SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+
+  iexec_forward_pid = pid;
+  for (int signum = 1; signum < NSIG; signum++) {
+    if (sigismember(&iexec_forward_set, signum) != 1) {
+      continue;
+    }
+    iexec_command_catch_signal(signum);
+    if (iexec_sigaction(signum, &action, NULL) == -1) {
+      iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "sigaction: %s\n",
+                   iexec_strerror(iexec_errno()));
+      iexec_exit(IEXEC_EXIT_FAILURE);
+    }
+  }
+}
+
+void iexec_forward_retarget(pid_t pid) {
+  iexec_forward_group_only = 0;
+  iexec_forward_pid = pid;
+}
+
+void iexec_forward_reaped(pid_t pid) {
+  // the kernel does not reuse the id of a group that still has members
+  if (iexec_forward_mode != IEXEC_FORWARD_MODE_CHILD &&
+      iexec_kill(-pid, 0) == 0) {
+    iexec_forward_group_only = 1;
+    iexec_forward_pid = pid;
+    return;
+  }
+  iexec_forward_retarget(-1);
+}
+
+const sigset_t *iexec_forward_signals(void) { return &iexec_forward_set; }
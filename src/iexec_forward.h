@@ -0,0 +1,80 @@
+#pragma once
+
+#include "iexec.h"
+#include "iexec_option.h"
+#include <signal.h>
+#include <sys/types.h>
+
+/**
+ * @brief Select the forwarded signals, their rewrites and the target mode
+ *
+ * By default SIGTERM, SIGINT, SIGHUP and SIGQUIT are forwarded; with
+ * --forward-all every catchable signal except the synchronous, job control
+ * and resource limit ones is. Sources of --signal-rewrite are always
+ * forwarded. The reload signal is never forwarded.
+ *
+ * @param ctx iexec_option_t context
+ */
+void iexec_forward_configure(const iexec_option_t *ctx);
+
+/**
+ * @brief Check whether a signal may be forwarded at all
+ *
+ * @param signum signal number
+ * @return non-zero unless the signal cannot be caught or is kept by iexec
+ */
+int iexec_forward_catchable(int signum);
+
+/**
+ * @brief Move a main command instance into its own process group or session
+ *
+ * Called in the child before exec with --forward=group or session. In group
+ * mode, a child started in the terminal's foreground group keeps the terminal.
+ */
+void iexec_forward_child(void);
+
+/**
+ * @brief Signal a main command instance the way forwarded signals are sent
+ *
+ * With --forward=group or session the signal goes to the instance's process
+ * group, or to the instance alone if it has not created its group yet.
+ *
+ * @param pid main command instance pid
+ * @param signum signal number
+ * @return kill result
+ */
+int iexec_forward_kill(pid_t pid, int signum);
+
+/**
+ * @brief Install the forwarding handlers and forward to pid
+ *
+ * @param pid main child pid
+ */
+void iexec_forward_start(pid_t pid);
+
+/**
+ * @brief Change the forwarding target
+ *
+ * Forwarded signals must be blocked by the caller.
+ *
+ * @param pid new main child pid, or -1 to stop forwarding
+ */
+void iexec_forward_retarget(pid_t pid);
+
+/**
+ * @brief Stop forwarding to a reaped main child
+ *
+ * With --forward=group or session, signals keep going to the child's process
+ * group, such as pre-fork workers, until the group has no members left.
+ * Forwarded signals must be blocked by the caller.
+ *
+ * @param pid reaped main child pid
+ */
+void iexec_forward_reaped(pid_t pid);
+
+/**
+ * @brief Forwarded signals
+ *
+ * @return set of the signals with a forwarding handler
+ */
+const sigset_t *iexec_forward_signals(void);
@@ -0,0 +1,102 @@
+#include "iexec_harden.h"
+#include "iexec_print.h"
+#include "iexec_process.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#define IEXEC_HARDEN_STACK_PREFAULT (128 * 1024)
+
+static int iexec_harden_oom_saved = 0;
+static char iexec_harden_oom_value[16];
+static int iexec_harden_nice_saved = 0;
+static int iexec_harden_nice_value = 0;
+
+static int iexec_harden_read_oom(char *buf, size_t size) {
+  int fd = open("/proc/self/oom_score_adj", O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return -1;
+  }
+  ssize_t len = read(fd, buf, size - 1);
+  close(fd);
+  if (len <= 0) {
+    return -1;
+  }
+  buf[len] = '\0';
+  buf[strcspn(buf, "\n")] = '\0';
+  return 0;
+}
+
+static int iexec_harden_write_oom(const char *value) {
+  int fd = open("/proc/self/oom_score_adj", O_WRONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return -1;
+  }
+  size_t len = strlen(value);
+  ssize_t ret = write(fd, value, len);
+  int saved_errno = errno;
+  close(fd);
+  errno = saved_errno;
+  return ret == (ssize_t)len ? 0 : -1;
+}
+
+// touch the stack once so the wait loop never page-faults growing it
+static void iexec_harden_prefault_stack(void) {
+  volatile char stack[IEXEC_HARDEN_STACK_PREFAULT];
+  for (size_t i = 0; i < sizeof(stack); i += 4096) {
+    stack[i] = 0;
+  }
+}
+
+void iexec_harden_apply(const iexec_option_t *ctx) {
+  if (!ctx->harden) {
+    return;
+  }
+
+  iexec_harden_prefault_stack();
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "Warning: mlockall: %s\n",
+                 iexec_strerror(iexec_errno()));
+  }
+
+  char value[16];
+  snprintf(value, sizeof(value), "%d", ctx->oom_score_adj);
+  if (iexec_harden_read_oom(iexec_harden_oom_value,
+                            sizeof(iexec_harden_oom_value)) == -1 ||
+      iexec_harden_write_oom(value) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "Warning: oom_score_adj: %s\n",
+                 iexec_strerror(iexec_errno()));
+  } else {
+    iexec_harden_oom_saved = 1;
+  }
+
+  errno = 0;
+  int nice_value = getpriority(PRIO_PROCESS, 0);
+  if (nice_value == -1 && errno != 0) {
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "Warning: getpriority: %s\n",
+                 iexec_strerror(iexec_errno()));
+  } else if (setpriority(PRIO_PROCESS, 0, ctx->nice) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "Warning: setpriority: %s\n",
+                 iexec_strerror(iexec_errno()));
+  } else {
+    iexec_harden_nice_value = nice_value;
+    iexec_harden_nice_saved = 1;
+  }
+}
+
+void iexec_harden_undo(void) {
+  if (iexec_harden_oom_saved &&
+      iexec_harden_write_oom(iexec_harden_oom_value) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "Warning: oom_score_adj: %s\n",
+                 iexec_strerror(iexec_errno()));
+  }
+  if (iexec_harden_nice_saved &&
+      setpriority(PRIO_PROCESS, 0, iexec_harden_nice_value) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "Warning: setpriority: %s\n",
+                 iexec_strerror(iexec_errno()));
+  }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "iexec.h"
+#include "iexec_option.h"
+
+/**
+ * @brief Protect iexec itself from reclaim, the OOM killer and CPU starvation
+ *
+ * Prefaults the stack, locks all memory with mlockall, lowers oom_score_adj
+ * and raises the scheduling priority. Each step only warns on failure. Call it
+ * after every long-lived buffer has been set up and before the first spawn.
+ *
+ * @param ctx iexec_option_t context
+ */
+void iexec_harden_apply(const iexec_option_t *ctx);
+
+/**
+ * @brief Restore the original oom_score_adj and priority in a spawned child
+ *
+ * Memory locks are not inherited across fork, so only the per-process
+ * settings need to be undone before exec.
+ */
+void iexec_harden_undo(void);
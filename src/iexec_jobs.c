@@ -0,0 +1,511 @@
+#include "iexec_jobs.h"
+#include "iexec_command.h"
+#include "iexec_forward.h"
+#include "iexec_journal.h"
+#include "iexec_print.h"
+#include "iexec_process.h"
+#include "iexec_syscall.h"
+#include "iexec_timeout.h"
+#include "iexec_trace.h"
+#include "iexec_wait.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define IEXEC_JOBS_READ_SIZE 65536
+
+typedef struct iexec_jobs_slot {
+  pid_t pid; /* 0 when free */
+  unsigned long seq;
+  struct timespec start;
+  char *command; /* reused by the slot's next job */
+  size_t command_size;
+} iexec_jobs_slot_t;
+
+static int iexec_jobs_template_argc = 0;
+static char **iexec_jobs_template_argv = NULL;
+static char iexec_jobs_delimiter = '\n';
+static int iexec_jobs_fail_fast = 0;
+static int iexec_jobs_rewrite[NSIG];
+static FILE *iexec_jobs_log = NULL;
+
+static int iexec_jobs_fd = -1;
+static int iexec_jobs_watching = 0;
+static int iexec_jobs_eof = 0;
+static int iexec_jobs_stopping = 0;
+static int iexec_jobs_null_fd = -1;
+static char *iexec_jobs_buf = NULL;
+static size_t iexec_jobs_buf_start = 0;
+static size_t iexec_jobs_buf_len = 0;
+static size_t iexec_jobs_buf_size = 0;
+/* scratch space to split one record, sized with the input buffer */
+static char **iexec_jobs_argv = NULL;
+static char *iexec_jobs_words = NULL;
+
+static iexec_jobs_slot_t *iexec_jobs_slots = NULL;
+static int iexec_jobs_parallel = 1;
+static int iexec_jobs_running = 0;
+static unsigned long iexec_jobs_seq = 0;
+static unsigned long iexec_jobs_failed = 0;
+static int iexec_jobs_status = -1;
+
+static volatile sig_atomic_t iexec_jobs_pending[NSIG];
+
+static void iexec_jobs_fatal(const char *what) {
+  iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "%s: %s\n", what,
+               iexec_strerror(iexec_errno()));
+  iexec_exit(IEXEC_EXIT_FAILURE);
+}
+
+/* buffers only grow for a record longer than any before it */
+static void iexec_jobs_reserve(size_t size) {
+  // a record of n bytes has at most n / 2 + 1 words
+  size_t max = (size_t)iexec_jobs_template_argc + size / 2 + 2;
+  iexec_jobs_buf = realloc(iexec_jobs_buf, size);
+  iexec_jobs_argv = realloc(iexec_jobs_argv, max * sizeof(*iexec_jobs_argv));
+  iexec_jobs_words = realloc(iexec_jobs_words, size);
+  if (iexec_jobs_buf == NULL || iexec_jobs_argv == NULL ||
+      iexec_jobs_words == NULL) {
+    iexec_jobs_fatal("realloc");
+  }
+  iexec_jobs_buf_size = size;
+}
+
+void iexec_jobs_configure(const iexec_option_t *ctx, int argc, char **argv) {
+  if (ctx->reload_signal != 0 || ctx->watchdog_interval != 0) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL,
+                 "--jobs cannot be combined with --reload or --watchdog\n");
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  iexec_jobs_template_argc = argc;
+  iexec_jobs_template_argv = argv;
+  iexec_jobs_delimiter = ctx->jobs_null ? '\0' : '\n';
+  iexec_jobs_fail_fast = ctx->jobs_fail_fast;
+  for (int signum = 0; signum < NSIG; signum++) {
+    iexec_jobs_rewrite[signum] = ctx->signal_rewrite[signum];
+  }
+
+  iexec_jobs_parallel = ctx->jobs_parallel;
+  iexec_jobs_slots =
+      calloc((size_t)iexec_jobs_parallel, sizeof(*iexec_jobs_slots));
+  if (iexec_jobs_slots == NULL) {
+    iexec_jobs_fatal("calloc");
+  }
+  iexec_jobs_reserve(IEXEC_JOBS_READ_SIZE);
+
+  if (strcmp(ctx->jobs_path, "-") == 0) {
+    iexec_jobs_fd = STDIN_FILENO;
+  } else {
+    iexec_jobs_fd = open(ctx->jobs_path, O_RDONLY | O_CLOEXEC);
+    if (iexec_jobs_fd == -1) {
+      iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "%s: %s\n", ctx->jobs_path,
+                   iexec_strerror(iexec_errno()));
+      iexec_exit(IEXEC_EXIT_FAILURE);
+    }
+  }
+  // jobs run in parallel, so none of them gets the terminal or the job list
+  iexec_jobs_null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  if (iexec_jobs_null_fd == -1) {
+    iexec_jobs_fatal("/dev/null");
+  }
+
+  if (ctx->jobs_log == NULL) {
+    iexec_jobs_log = stderr;
+  } else {
+    iexec_jobs_log = fopen(ctx->jobs_log, "we");
+    if (iexec_jobs_log == NULL) {
+      iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "%s: %s\n", ctx->jobs_log,
+                   iexec_strerror(iexec_errno()));
+      iexec_exit(IEXEC_EXIT_FAILURE);
+    }
+  }
+  setvbuf(iexec_jobs_log, NULL, _IOLBF, 0);
+  iexec_printf(IEXEC_PRINT_LEVEL_INFORMATION, "jobs: parallel=%d\n",
+               iexec_jobs_parallel);
+}
+
+static void iexec_jobs_fail(int status) {
+  iexec_jobs_failed++;
+  if (iexec_jobs_status == -1) {
+    iexec_jobs_status = status;
+  }
+  if (!iexec_jobs_fail_fast || iexec_jobs_stopping) {
+    return;
+  }
+  iexec_jobs_stopping = 1;
+  for (int i = 0; i < iexec_jobs_parallel; i++) {
+    if (iexec_jobs_slots[i].pid > 0) {
+      iexec_forward_kill(iexec_jobs_slots[i].pid, SIGTERM);
+    }
+  }
+}
+
+static void iexec_jobs_print_time(const char *name, long sec, long usec) {
+  fprintf(iexec_jobs_log, " %s=%ld.%06ld", name, sec, usec);
+}
+
+static void iexec_jobs_report(const iexec_jobs_slot_t *slot, int status,
+                              const struct rusage *usage,
+                              iexec_timeout_limit_t limit) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  long nsec = (long)(end.tv_nsec - slot->start.tv_nsec);
+  long sec = (long)(end.tv_sec - slot->start.tv_sec);
+  if (nsec < 0) {
+    nsec += 1000000000L;
+    sec--;
+  }
+
+  fprintf(iexec_jobs_log, "job=%lu pid=%d", slot->seq, (int)slot->pid);
+  if (WIFSIGNALED(status)) {
+    const char *name = sigabbrev_np(WTERMSIG(status));
+    if (name != NULL) {
+      fprintf(iexec_jobs_log, " signal=%s", name);
+    } else {
+      fprintf(iexec_jobs_log, " signal=%d", WTERMSIG(status));
+    }
+  } else {
+    fprintf(iexec_jobs_log, " exit=%d", WEXITSTATUS(status));
+  }
+  if (limit == IEXEC_TIMEOUT_LIMIT_WALL) {
+    fprintf(iexec_jobs_log, " limit=timeout");
+  } else if (limit == IEXEC_TIMEOUT_LIMIT_CPU) {
+    fprintf(iexec_jobs_log, " limit=cpu");
+  }
+  iexec_jobs_print_time("wall", sec, nsec / 1000);
+  iexec_jobs_print_time("user", (long)usage->ru_utime.tv_sec,
+                        (long)usage->ru_utime.tv_usec);
+  iexec_jobs_print_time("sys", (long)usage->ru_stime.tv_sec,
+                        (long)usage->ru_stime.tv_usec);
+  fprintf(iexec_jobs_log, " maxrss=%ld command=%s\n", usage->ru_maxrss,
+          slot->command);
+}
+
+static void iexec_jobs_report_error(unsigned long seq, const char *error,
+                                    const char *command) {
+  fprintf(iexec_jobs_log, "job=%lu error=%s command=%s\n", seq, error,
+          command);
+}
+
+/* blanks separate words; quotes and backslashes work as in xargs */
+static int iexec_jobs_split(const char *in, char *out, char **words) {
+  int count = 0;
+  while (1) {
+    while (*in == ' ' || *in == '\t') {
+      in++;
+    }
+    if (*in == '\0') {
+      return count;
+    }
+    words[count++] = out;
+    char quote = '\0';
+    while (*in != '\0' && (quote != '\0' || (*in != ' ' && *in != '\t'))) {
+      if (quote != '\0' && *in == quote) {
+        quote = '\0';
+        in++;
+        continue;
+      }
+      if (quote == '\0' && (*in == '\'' || *in == '"')) {
+        quote = *in++;
+        continue;
+      }
+      if (*in == '\\' && quote != '\'') {
+        in++;
+        if (*in == '\0') {
+          return -1;
+        }
+      }
+      *out++ = *in++;
+    }
+    if (quote != '\0') {
+      return -1;
+    }
+    *out++ = '\0';
+  }
+}
+
+static char *iexec_jobs_join(iexec_jobs_slot_t *slot, char **argv,
+                             int argc) {
+  size_t size = 1;
+  for (int i = 0; i < argc; i++) {
+    size += strlen(argv[i]) + 1;
+  }
+  if (size > slot->command_size) {
+    char *grown = realloc(slot->command, size);
+    if (grown == NULL) {
+      iexec_jobs_fatal("realloc");
+    }
+    slot->command = grown;
+    slot->command_size = size;
+  }
+  char *command = slot->command;
+  char *p = command;
+  for (int i = 0; i < argc; i++) {
+    size_t len = strlen(argv[i]);
+    if (i > 0) {
+      *p++ = ' ';
+    }
+    memcpy(p, argv[i], len);
+    p += len;
+  }
+  *p = '\0';
+  // one result per line, even for records with newlines
+  for (p = command; *p != '\0'; p++) {
+    if (*p == '\n' || *p == '\r') {
+      *p = ' ';
+    }
+  }
+  return command;
+}
+
+static void iexec_jobs_prepare(void *arg) {
+  (void)arg;
+  if (dup2(iexec_jobs_null_fd, STDIN_FILENO) == -1) {
+    iexec_jobs_fatal("dup2");
+  }
+  iexec_forward_child();
+  iexec_timeout_child();
+}
+
+static int iexec_jobs_launch(iexec_jobs_slot_t *slot, char **argv,
+                             int cmdind) {
+  clock_gettime(CLOCK_MONOTONIC, &slot->start);
+  pid_t pid = iexec_command_spawn_argv(argv, cmdind, iexec_jobs_prepare, NULL);
+  if (pid == -1) {
+    return -1;
+  }
+  slot->pid = pid;
+  slot->seq = iexec_jobs_seq;
+  iexec_jobs_running++;
+  iexec_timeout_watch(pid);
+  return 0;
+}
+
+/* called only while a slot is free; its command buffer is used for errors */
+static void iexec_jobs_spawn(char *record, size_t len) {
+  iexec_jobs_slot_t *slot = iexec_jobs_slots;
+  while (slot->pid != 0) {
+    slot++;
+  }
+  char **argv = iexec_jobs_argv;
+  memcpy(argv, iexec_jobs_template_argv,
+         (size_t)iexec_jobs_template_argc * sizeof(*argv));
+  int argc = iexec_jobs_template_argc;
+  int count = 1;
+  if (iexec_jobs_delimiter == '\0') {
+    argv[argc] = record;
+  } else {
+    count = iexec_jobs_split(record, iexec_jobs_words, argv + argc);
+  }
+
+  const char *error = NULL;
+  const char *command = NULL;
+  if (len > 0 && count != 0) {
+    iexec_jobs_seq++;
+    if (count == -1) {
+      error = "syntax";
+      command = iexec_jobs_join(slot, &record, 1);
+    } else {
+      argc += count;
+      argv[argc] = NULL;
+      // only NAME=value assignments: report them as the command
+      int cmdind = iexec_parse_command_index(argc, argv);
+      if (cmdind == argc) {
+        error = "nocommand";
+        command = iexec_jobs_join(slot, argv, argc);
+      } else {
+        command = iexec_jobs_join(slot, argv + cmdind, argc - cmdind);
+        if (iexec_jobs_launch(slot, argv, cmdind) == -1) {
+          error = "fork";
+        }
+      }
+    }
+  }
+  if (error != NULL) {
+    iexec_jobs_report_error(iexec_jobs_seq, error, command);
+    iexec_jobs_fail(IEXEC_EXIT_FAILURE << 8);
+  }
+}
+
+static char *iexec_jobs_next_record(size_t *len) {
+  char *start = iexec_jobs_buf + iexec_jobs_buf_start;
+  size_t avail = iexec_jobs_buf_len - iexec_jobs_buf_start;
+  if (avail == 0) {
+    return NULL;
+  }
+  char *end = memchr(start, iexec_jobs_delimiter, avail);
+  if (end == NULL) {
+    if (!iexec_jobs_eof) {
+      return NULL;
+    }
+    // the last record may lack its delimiter; the buffer has room for a NUL
+    end = start + avail;
+    iexec_jobs_buf_start = iexec_jobs_buf_len;
+  } else {
+    iexec_jobs_buf_start += (size_t)(end - start) + 1;
+  }
+  *end = '\0';
+  *len = (size_t)(end - start);
+  return start;
+}
+
+static void iexec_jobs_on_input(int fd, void *arg);
+
+static void iexec_jobs_fill(void) {
+  size_t len;
+  char *record;
+  while (!iexec_jobs_stopping && iexec_jobs_running < iexec_jobs_parallel &&
+         (record = iexec_jobs_next_record(&len)) != NULL) {
+    iexec_jobs_spawn(record, len);
+  }
+
+  // read more only when a slot is free and no record is left
+  int done = iexec_jobs_eof || iexec_jobs_stopping;
+  int want = !done && iexec_jobs_running < iexec_jobs_parallel;
+  if (want && !iexec_jobs_watching) {
+    if (iexec_wait_add_fd(iexec_jobs_fd, iexec_jobs_on_input, NULL) == -1) {
+      // the rest of the list cannot be read, so the batch fails
+      iexec_jobs_eof = 1;
+      if (iexec_jobs_status == -1) {
+        iexec_jobs_status = W_EXITCODE(IEXEC_EXIT_FAILURE, 0);
+      }
+      done = 1;
+    } else {
+      iexec_jobs_watching = 1;
+    }
+  } else if (!want && iexec_jobs_watching) {
+    iexec_wait_remove_fd(iexec_jobs_fd);
+    iexec_jobs_watching = 0;
+  }
+  if (done && iexec_jobs_fd != -1) {
+    if (iexec_jobs_fd != STDIN_FILENO) {
+      close(iexec_jobs_fd);
+    }
+    iexec_jobs_fd = -1;
+  }
+}
+
+static void iexec_jobs_on_input(int fd, void *arg) {
+  (void)arg;
+  if (iexec_jobs_buf_start > 0) {
+    memmove(iexec_jobs_buf, iexec_jobs_buf + iexec_jobs_buf_start,
+            iexec_jobs_buf_len - iexec_jobs_buf_start);
+    iexec_jobs_buf_len -= iexec_jobs_buf_start;
+    iexec_jobs_buf_start = 0;
+  }
+  // keep a spare byte to terminate a last record without a delimiter
+  if (iexec_jobs_buf_size - iexec_jobs_buf_len < IEXEC_JOBS_READ_SIZE / 2) {
+    iexec_jobs_reserve(iexec_jobs_buf_size * 2);
+  }
+  ssize_t n = read(fd, iexec_jobs_buf + iexec_jobs_buf_len,
+                   iexec_jobs_buf_size - iexec_jobs_buf_len - 1);
+  if (n == -1) {
+    if (errno == EINTR || errno == EAGAIN) {
+      return;
+    }
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "Warning: read jobs: %s\n",
+                 iexec_strerror(iexec_errno()));
+    n = 0;
+  }
+  if (n == 0) {
+    iexec_jobs_eof = 1;
+  }
+  iexec_jobs_buf_len += (size_t)n;
+  iexec_jobs_fill();
+}
+
+static void iexec_jobs_handler(int signum) {
+  int saved_errno = errno;
+  iexec_journal_record(IEXEC_JOURNAL_SIGNAL, 0, signum, 0);
+  iexec_jobs_pending[signum] = 1;
+  errno = saved_errno;
+}
+
+void iexec_jobs_start(void) {
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = iexec_jobs_handler;
+  sigemptyset(&action.sa_mask);
+  for (int signum = 1; signum < NSIG; signum++) {
+    if (sigismember(iexec_forward_signals(), signum) != 1) {
+      continue;
+    }
+    iexec_command_catch_signal(signum);
+    if (iexec_sigaction(signum, &action, NULL) == -1) {
+      iexec_jobs_fatal("sigaction");
+    }
+  }
+  iexec_jobs_fill();
+}
+
+int iexec_jobs_reaped(pid_t pid, int status, const struct rusage *usage) {
+  iexec_jobs_slot_t *slot = NULL;
+  for (int i = 0; i < iexec_jobs_parallel; i++) {
+    if (iexec_jobs_slots[i].pid == pid) {
+      slot = &iexec_jobs_slots[i];
+      break;
+    }
+  }
+  if (slot == NULL) {
+    return 0;
+  }
+  iexec_timeout_limit_t limit = iexec_timeout_reaped(pid, status, usage);
+  iexec_jobs_report(slot, status, usage, limit);
+  slot->pid = 0;
+  iexec_jobs_running--;
+  if (limit != IEXEC_TIMEOUT_LIMIT_NONE) {
+    iexec_jobs_fail(IEXEC_EXIT_TIMEOUT << 8);
+  } else if (status != 0) {
+    iexec_jobs_fail(status);
+  }
+  iexec_jobs_fill();
+  return 1;
+}
+
+void iexec_jobs_take_signals(void) {
+  for (int signum = 1; signum < NSIG; signum++) {
+    if (!iexec_jobs_pending[signum]) {
+      continue;
+    }
+    iexec_jobs_pending[signum] = 0;
+    if (signum == SIGTERM || signum == SIGINT || signum == SIGHUP ||
+        signum == SIGQUIT) {
+      // exit as if terminated by the signal, like a main child would
+      if (iexec_jobs_status == -1) {
+        iexec_jobs_status = W_EXITCODE(0, signum);
+      }
+      iexec_jobs_stopping = 1;
+    }
+    int signum_out = iexec_jobs_rewrite[signum];
+    for (int i = 0; signum_out != 0 && i < iexec_jobs_parallel; i++) {
+      pid_t pid = iexec_jobs_slots[i].pid;
+      if (pid <= 0) {
+        continue;
+      }
+      int ret = iexec_forward_kill(pid, signum_out);
+      IEXEC_TRACE4(forward, signum, signum_out, pid, ret);
+      iexec_journal_record(IEXEC_JOURNAL_FORWARD, pid, signum_out, ret);
+    }
+  }
+  iexec_jobs_fill();
+}
+
+int iexec_jobs_finished(void) {
+  return iexec_jobs_fd == -1 && iexec_jobs_running == 0;
+}
+
+void iexec_jobs_exit(void) {
+  fflush(iexec_jobs_log);
+  iexec_printf(IEXEC_PRINT_LEVEL_INFORMATION, "jobs: %lu run, %lu failed\n",
+               iexec_jobs_seq, iexec_jobs_failed);
+  if (iexec_jobs_status != -1) {
+    iexec_exit_from_wait_status(iexec_jobs_status);
+  }
+  iexec_exit(IEXEC_EXIT_SUCCESS);
+}
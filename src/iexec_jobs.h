@@ -0,0 +1,59 @@
+#pragma once
+
+#include "iexec.h"
+#include "iexec_option.h"
+#include <sys/resource.h>
+#include <sys/types.h>
+
+/**
+ * @brief Prepare the job runner for --jobs
+ *
+ * Opens the job list and the result log. Each record of the list is split
+ * into arguments (a whole NUL-separated record is one argument) which are
+ * appended to COMMAND [ARG]..., or make up the command when none is given.
+ * A --parallel of 0 must already be resolved to the CPU count.
+ *
+ * @param ctx iexec_option_t context
+ * @param argc number of template arguments, NAME=value assignments included
+ * @param argv template arguments
+ */
+void iexec_jobs_configure(const iexec_option_t *ctx, int argc, char **argv);
+
+/**
+ * @brief Install the signal handlers and start reading the job list
+ *
+ * Jobs are spawned from the wait loop as records come in, at most
+ * --parallel at a time.
+ */
+void iexec_jobs_start(void);
+
+/**
+ * @brief Handle a reaped child
+ *
+ * A job gets its result line and its slot goes to the next record.
+ *
+ * @param pid reaped child
+ * @param status wait status
+ * @param usage resource usage of the child
+ * @return 1 if pid was a job, 0 for any other descendant
+ */
+int iexec_jobs_reaped(pid_t pid, int status, const struct rusage *usage);
+
+/**
+ * @brief Forward the signals received while sleeping to every running job
+ *
+ * SIGTERM, SIGINT, SIGHUP and SIGQUIT also stop reading the job list.
+ */
+void iexec_jobs_take_signals(void);
+
+/**
+ * @brief Check whether every job has been run and reaped
+ *
+ * @return 1 if the job list is exhausted (or abandoned) and no job runs
+ */
+int iexec_jobs_finished(void);
+
+/**
+ * @brief Exit with the status of the first failed job, or 0
+ */
+void iexec_jobs_exit(void) __attribute__((noreturn));
@@ -0,0 +1,136 @@
+#include "iexec_journal.h"
+#include "iexec_print.h"
+#include "iexec_process.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static iexec_journal_header_t *iexec_journal_header = NULL;
+static iexec_journal_record_t *iexec_journal_records = NULL;
+static pid_t iexec_journal_self = 0;
+static int iexec_journal_is_child = 0;
+static pid_t iexec_journal_comm_pid = 0;
+static char iexec_journal_comm[16];
+
+static uint64_t iexec_journal_now(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int iexec_journal_is_compatible(const iexec_journal_header_t *header,
+                                       uint64_t capacity) {
+  return memcmp(header->magic, IEXEC_JOURNAL_MAGIC, sizeof(header->magic)) ==
+             0 &&
+         header->version == IEXEC_JOURNAL_VERSION &&
+         header->record_size == sizeof(iexec_journal_record_t) &&
+         header->capacity == capacity;
+}
+
+void iexec_journal_open(const char *path, int records) {
+  if (path == NULL) {
+    return;
+  }
+  size_t size = sizeof(iexec_journal_header_t) +
+                sizeof(iexec_journal_record_t) * (size_t)records;
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "open journal %s: %s\n", path,
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "fstat journal %s: %s\n", path,
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  int reuse = (size_t)st.st_size == size;
+  if (!reuse && ftruncate(fd, (off_t)size) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "ftruncate journal %s: %s\n", path,
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "mmap journal %s: %s\n", path,
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  close(fd);
+
+  iexec_journal_header_t *header = map;
+  if (!reuse || !iexec_journal_is_compatible(header, (uint64_t)records)) {
+    memset(map, 0, size);
+    memcpy(header->magic, IEXEC_JOURNAL_MAGIC, sizeof(header->magic));
+    header->version = IEXEC_JOURNAL_VERSION;
+    header->record_size = sizeof(iexec_journal_record_t);
+    header->capacity = (uint64_t)records;
+  }
+  header->open_realtime_ns = iexec_journal_now(CLOCK_REALTIME);
+  header->open_monotonic_ns = iexec_journal_now(CLOCK_MONOTONIC);
+  iexec_journal_records = (iexec_journal_record_t *)(header + 1);
+  iexec_journal_self = iexec_getpid();
+  __atomic_store_n(&iexec_journal_header, header, __ATOMIC_RELEASE);
+  iexec_journal_record(IEXEC_JOURNAL_START, iexec_journal_self, 0, 0);
+}
+
+int iexec_journal_enabled(void) { return iexec_journal_header != NULL; }
+
+void iexec_journal_forked(void) { iexec_journal_is_child = 1; }
+
+void iexec_journal_stage_comm(pid_t pid) {
+  char path[32];
+  iexec_journal_comm_pid = pid;
+  memset(iexec_journal_comm, 0, sizeof(iexec_journal_comm));
+  snprintf(path, sizeof(path), "/proc/%d/comm", (int)pid);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return;
+  }
+  ssize_t len = read(fd, iexec_journal_comm, sizeof(iexec_journal_comm) - 1);
+  close(fd);
+  if (len > 0 && iexec_journal_comm[len - 1] == '\n') {
+    iexec_journal_comm[len - 1] = '\0';
+  }
+}
+
+void iexec_journal_record(iexec_journal_type_t type, pid_t pid, int arg0,
+                          int arg1) {
+  iexec_journal_header_t *header =
+      __atomic_load_n(&iexec_journal_header, __ATOMIC_ACQUIRE);
+  if (header == NULL) {
+    return;
+  }
+  uint64_t seq = __atomic_add_fetch(&header->head, 1, __ATOMIC_ACQ_REL);
+  iexec_journal_record_t *record =
+      &iexec_journal_records[(seq - 1) % header->capacity];
+  __atomic_store_n(&record->seq, 0, __ATOMIC_RELEASE);
+  record->time_ns = iexec_journal_now(CLOCK_MONOTONIC);
+  record->type = (uint16_t)type;
+  record->reserved = 0;
+  record->pid = pid;
+  record->arg0 = arg0;
+  record->arg1 = arg1;
+  if (type == IEXEC_JOURNAL_REAP && pid == iexec_journal_comm_pid) {
+    memcpy(record->comm, iexec_journal_comm, sizeof(record->comm));
+  } else {
+    memset(record->comm, 0, sizeof(record->comm));
+  }
+  __atomic_store_n(&record->seq, seq, __ATOMIC_RELEASE);
+}
+
+void iexec_journal_record_self(iexec_journal_type_t type, int arg0) {
+  if (iexec_journal_header == NULL) {
+    return;
+  }
+  if (!iexec_journal_is_child) {
+    iexec_journal_record(type, iexec_journal_self, arg0, 0);
+  } else if (type != IEXEC_JOURNAL_EXIT) {
+    iexec_journal_record(type, iexec_getpid(), arg0, 0);
+  }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "iexec.h"
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Journal file layout: one iexec_journal_header_t followed by `capacity`
+ * iexec_journal_record_t slots used as a ring. Record N (1-based) lives in slot
+ * (N - 1) % capacity and is complete once its seq field equals N.
+ */
+
+#define IEXEC_JOURNAL_MAGIC "IEXECJNL"
+#define IEXEC_JOURNAL_VERSION 1
+#define IEXEC_JOURNAL_DEFAULT_RECORDS 4096
+
+typedef enum iexec_journal_type {
+  IEXEC_JOURNAL_START = 1,  /* pid: iexec pid */
+  IEXEC_JOURNAL_SPAWN,      /* pid: child pid */
+  IEXEC_JOURNAL_EXEC_START, /* pid: child pid */
+  IEXEC_JOURNAL_EXEC_FAIL,  /* pid: child pid, arg0: errno */
+  IEXEC_JOURNAL_REAP,       /* pid, arg0: wait status, arg1: is main, comm */
+  IEXEC_JOURNAL_SIGNAL,     /* arg0: signal received by iexec */
+  IEXEC_JOURNAL_FORWARD,    /* pid: target, arg0: signal, arg1: kill result */
+  IEXEC_JOURNAL_RELOAD,     /* pid: new main child, arg0: old main child */
+  IEXEC_JOURNAL_RELOAD_FAIL, /* pid: rejected instance */
+  IEXEC_JOURNAL_EXIT,       /* arg0: iexec exit status */
+  IEXEC_JOURNAL_WATCHDOG,   /* pid: main child, arg0: signal, arg1: missed */
+  IEXEC_JOURNAL_TIMEOUT     /* pid: child, arg0: signal, arg1: tree signaled */
+} iexec_journal_type_t;
+
+typedef struct iexec_journal_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t capacity;
+  uint64_t head;
+  uint64_t open_realtime_ns;
+  uint64_t open_monotonic_ns;
+  uint64_t reserved[2];
+} iexec_journal_header_t;
+
+typedef struct iexec_journal_record {
+  uint64_t seq;
+  uint64_t time_ns;
+  uint16_t type;
+  uint16_t reserved;
+  int32_t pid;
+  int32_t arg0;
+  int32_t arg1;
+  char comm[16];
+} iexec_journal_record_t;
+
+/**
+ * @brief Map the journal file, creating or resetting it when needed
+ *
+ * An existing journal with the same geometry is appended to, so events from
+ * earlier runs survive a restart.
+ *
+ * @param path journal file path
+ * @param records number of record slots
+ */
+void iexec_journal_open(const char *path, int records);
+
+/**
+ * @brief Check whether the journal is mapped
+ *
+ * @return non-zero when events are being recorded
+ */
+int iexec_journal_enabled(void);
+
+/**
+ * @brief Mark the current process as a forked child of iexec
+ *
+ * Events recorded by the child carry its own pid, and its exit is not
+ * recorded as an iexec exit.
+ */
+void iexec_journal_forked(void);
+
+/**
+ * @brief Remember the name of a child that is about to be reaped
+ *
+ * @param pid pid of the exited, not yet reaped child
+ */
+void iexec_journal_stage_comm(pid_t pid);
+
+/**
+ * @brief Append an event (async-signal-safe, no syscalls)
+ *
+ * @param type event type
+ * @param pid pid the event is about
+ * @param arg0 first event argument
+ * @param arg1 second event argument
+ */
+void iexec_journal_record(iexec_journal_type_t type, pid_t pid, int arg0,
+                          int arg1);
+
+/**
+ * @brief Append an event about the calling process
+ *
+ * @param type event type
+ * @param arg0 first event argument
+ */
+void iexec_journal_record_self(iexec_journal_type_t type, int arg0);
@@ -1,9 +1,21 @@
 #include "iexec_main.h"
+#include "iexec_cgroup.h"
+#include "iexec_command.h"
+#include "iexec_control.h"
+#include "iexec_forward.h"
+#include "iexec_harden.h"
+#include "iexec_jobs.h"
+#include "iexec_journal.h"
 #include "iexec_pidns.h"
+#include "iexec_prewarm.h"
 #include "iexec_print.h"
 #include "iexec_privilege.h"
 #include "iexec_process.h"
+#include "iexec_proctree.h"
+#include "iexec_reload.h"
+#include "iexec_timeout.h"
 #include "iexec_wait.h"
+#include "iexec_watchdog.h"
 
 void iexec_mainloop(int argc, char **argv, iexec_option_t *ctx) {
   pid_t pid_self = iexec_getpid();
@@ -16,14 +28,35 @@ void iexec_mainloop(int argc, char **argv, iexec_option_t *ctx) {
     iexec_prctl_set_pdeathsig(ctx->deathsig);
   }
 
+  iexec_command_save_sigmask();
+  iexec_journal_open(ctx->journal_path, ctx->journal_records);
+  iexec_control_listen(ctx->control_path);
+  iexec_proctree_start(ctx);
+  iexec_cgroup_env_configure(ctx);
+
   int cmdind = iexec_parse_command_index(argc, argv);
+  iexec_prewarm(ctx, argc, argv, cmdind);
+  // resolved once, so that the job slots and the timeout table agree
+  if (ctx->jobs_path != NULL && ctx->jobs_parallel == 0) {
+    long cpus = iexec_cgroup_cpus(ctx->cpu_rounding);
+    ctx->jobs_parallel = cpus < 1 ? 1 : (int)cpus;
+  }
+  iexec_harden_apply(ctx);
+  iexec_timeout_configure(ctx);
+
+  if (ctx->jobs_path != NULL) {
+    iexec_jobs_configure(ctx, argc, argv);
+    iexec_wait_for_jobs();
+  }
 
   pid_t pid_child = -1;
   if (cmdind < argc) {
-    pid_child = iexec_fork();
-    if (pid_child == 0) {
-      iexec_put_envs(cmdind, argv);
-      iexec_execvp(argv[cmdind], argv + cmdind);
+    iexec_command_init(argv, cmdind);
+    iexec_reload_configure(ctx);
+    iexec_watchdog_configure(ctx);
+    pid_child = iexec_command_spawn(NULL, NULL);
+    if (pid_child == -1) {
+      iexec_exit(IEXEC_EXIT_FAILURE);
     }
   } else if (pid_self != 1) {
     iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "No command specified\n");
@@ -58,6 +91,15 @@ void iexec_print_warning(iexec_option_t *ctx) {
 void iexec_main(int argc, char **argv, iexec_option_t *ctx) {
   argc -= ctx->envind;
   argv += ctx->envind;
+  if (ctx->stats_path != NULL) {
+    iexec_drop_privilege_permanently();
+    iexec_control_stats(ctx->stats_path);
+  }
+  if (ctx->attach_path != NULL) {
+    iexec_drop_privilege_permanently();
+    iexec_control_attach(ctx->attach_path, argc, argv);
+  }
+  iexec_forward_configure(ctx);
   if (ctx->pidns != IEXEC_PIDNS_MODE_INHERIT &&
       !ctx->allow_privileged_pidns) {
     iexec_printf(IEXEC_PRINT_LEVEL_ERROR,
@@ -1,12 +1,18 @@
 #include "iexec_option.h"
+#include "iexec_forward.h"
+#include "iexec_journal.h"
 #include "iexec_print.h"
 #include "iexec_process.h"
+#include <ctype.h>
 #include <errno.h>
 #include <getopt.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define IEXEC_OPTION_MAX_PARALLEL 4096
+
 static int iexec_option_parse_signal(const char *sigspec) {
   if (sigspec == NULL || *sigspec == '\0') {
     return -1;
@@ -27,6 +33,22 @@ static int iexec_option_parse_signal(const char *sigspec) {
   if (strncasecmp(sigspec, "SIG", 3) == 0) {
     sigspec += 3;
   }
+  if (strncasecmp(sigspec, "RTMIN", 5) == 0 ||
+      strncasecmp(sigspec, "RTMAX", 5) == 0) {
+    int base = toupper((unsigned char)sigspec[4]) == 'N' ? SIGRTMIN : SIGRTMAX;
+    long offset = 0;
+    if (sigspec[5] != '\0') {
+      char *p;
+      offset = strtol(sigspec + 5, &p, 10);
+      if (*p != '\0' || (sigspec[5] != '+' && sigspec[5] != '-')) {
+        return -1;
+      }
+    }
+    if (base + offset < SIGRTMIN || base + offset > SIGRTMAX) {
+      return -1;
+    }
+    return base + (int)offset;
+  }
   for (int signum = 1; signum < NSIG; signum++) {
     const char *signame = sigabbrev_np(signum);
     if (signame == NULL) {
@@ -39,6 +61,159 @@ static int iexec_option_parse_signal(const char *sigspec) {
   return -1;
 }
 
+static int iexec_option_parse_uint(const char *spec) {
+  if (spec == NULL || *spec == '\0') {
+    return -1;
+  }
+  char *p;
+  errno = 0;
+  long value = strtol(spec, &p, 10);
+  if (*p != '\0' || errno != 0 || value < 0 || value > INT_MAX) {
+    return -1;
+  }
+  return value;
+}
+
+static int iexec_option_parse_int(const char *spec, int min, int max,
+                                  int *value) {
+  if (spec == NULL || *spec == '\0') {
+    return -1;
+  }
+  char *p;
+  errno = 0;
+  long parsed = strtol(spec, &p, 10);
+  if (*p != '\0' || errno != 0 || parsed < min || parsed > max) {
+    return -1;
+  }
+  *value = (int)parsed;
+  return 0;
+}
+
+static int iexec_option_parse_duration(const char *spec, long long *ms) {
+  // NUMBER[SUFFIX] in seconds, minutes, hours or days, as timeout(1) takes
+  if (spec == NULL || *spec == '\0') {
+    return -1;
+  }
+  char *p;
+  errno = 0;
+  double value = strtod(spec, &p);
+  if (p == spec || errno != 0 || !(value >= 0)) {
+    return -1;
+  }
+  switch (*p) {
+  case '\0':
+  case 's':
+    break;
+  case 'm':
+    value *= 60;
+    break;
+  case 'h':
+    value *= 60 * 60;
+    break;
+  case 'd':
+    value *= 24 * 60 * 60;
+    break;
+  default:
+    return -1;
+  }
+  if (*p != '\0' && p[1] != '\0') {
+    return -1;
+  }
+  value *= 1000;
+  if (value > (double)INT_MAX * 1000) {
+    return -1;
+  }
+  // round up, so a tiny timeout is not taken as none
+  *ms = (long long)value;
+  if ((double)*ms < value) {
+    (*ms)++;
+  }
+  return 0;
+}
+
+static int iexec_option_parse_proctree_mode(const char *mode,
+                                            iexec_option_t *ctx) {
+  if (mode == NULL || strcasecmp(mode, "auto") == 0) {
+    ctx->proctree = IEXEC_PROCTREE_MODE_AUTO;
+    return 0;
+  }
+  if (strcasecmp(mode, "netlink") == 0) {
+    ctx->proctree = IEXEC_PROCTREE_MODE_NETLINK;
+    return 0;
+  }
+  if (strcasecmp(mode, "proc") == 0) {
+    ctx->proctree = IEXEC_PROCTREE_MODE_PROC;
+    return 0;
+  }
+  return -1;
+}
+
+static int iexec_option_parse_cpu_rounding(const char *rounding,
+                                            iexec_option_t *ctx) {
+  if (strcasecmp(rounding, "floor") == 0) {
+    ctx->cpu_rounding = IEXEC_CPU_ROUNDING_FLOOR;
+    return 0;
+  }
+  if (strcasecmp(rounding, "ceil") == 0) {
+    ctx->cpu_rounding = IEXEC_CPU_ROUNDING_CEIL;
+    return 0;
+  }
+  if (strcasecmp(rounding, "nearest") == 0) {
+    ctx->cpu_rounding = IEXEC_CPU_ROUNDING_NEAREST;
+    return 0;
+  }
+  return -1;
+}
+
+static int iexec_option_parse_forward_mode(const char *mode,
+                                           iexec_option_t *ctx) {
+  if (strcasecmp(mode, "child") == 0) {
+    ctx->forward = IEXEC_FORWARD_MODE_CHILD;
+    return 0;
+  }
+  if (strcasecmp(mode, "group") == 0) {
+    ctx->forward = IEXEC_FORWARD_MODE_GROUP;
+    return 0;
+  }
+  if (strcasecmp(mode, "session") == 0) {
+    ctx->forward = IEXEC_FORWARD_MODE_SESSION;
+    return 0;
+  }
+  return -1;
+}
+
+static int iexec_option_parse_signal_rewrite(const char *spec,
+                                             iexec_option_t *ctx) {
+  // FROM:TO[,FROM:TO]...
+  char buf[32];
+  while (*spec != '\0') {
+    size_t len = strcspn(spec, ",");
+    if (len == 0 || len >= sizeof(buf)) {
+      return -1;
+    }
+    memcpy(buf, spec, len);
+    buf[len] = '\0';
+    char *to = strchr(buf, ':');
+    if (to == NULL) {
+      return -1;
+    }
+    *to++ = '\0';
+    int signum_from = iexec_option_parse_signal(buf);
+    int signum_to = iexec_option_parse_signal(to);
+    // a source that is never caught would be accepted but do nothing
+    if (signum_from <= 0 || signum_to == -1 ||
+        !iexec_forward_catchable(signum_from)) {
+      return -1;
+    }
+    ctx->signal_rewrite[signum_from] = signum_to;
+    spec += len;
+    if (*spec == ',') {
+      spec++;
+    }
+  }
+  return 0;
+}
+
 static int iexec_option_parse_pidns_mode(const char *pidns, iexec_option_t *ctx) {
   if (pidns == NULL || *pidns == '\0') {
     ctx->pidns = IEXEC_PIDNS_MODE_NEW;
@@ -108,6 +283,78 @@ void iexec_option_print_usage(FILE *stream) {
                   "file (\"file:\" can omit)\n");
   fprintf(stream, "        fd:FD                     enter PID namespace by "
                   "file descriptor\n");
+  fprintf(stream, "      --reload[=SIGNAL]         hand over to a new COMMAND on "
+                  "SIGNAL (default: HUP)\n");
+  fprintf(stream, "      --reload-timeout=SECONDS  readiness timeout for reload "
+                  "(default: 10)\n");
+  fprintf(stream, "      --reload-stop-signal=SIGNAL signal for the replaced "
+                  "COMMAND (default: TERM)\n");
+  fprintf(stream, "      --journal=PATH            record lifecycle events in a "
+                  "mmap'd ring file\n");
+  fprintf(stream, "      --journal-records=COUNT   number of journal records "
+                  "(default: %d)\n", IEXEC_JOURNAL_DEFAULT_RECORDS);
+  fprintf(stream, "      --control-socket=PATH     accept --attach requests on "
+                  "a Unix socket\n");
+  fprintf(stream, "      --attach=PATH             run COMMAND as a child of the "
+                  "iexec serving PATH\n");
+  fprintf(stream, "      --stats=PATH              print metrics of the iexec "
+                  "serving PATH\n");
+  fprintf(stream, "      --track-tree[=MODE]       track descendants (auto, "
+                  "netlink, proc)\n");
+  fprintf(stream, "      --track-interval=SECONDS  /proc scan interval "
+                  "(default: 1)\n");
+  fprintf(stream, "      --fork-storm-rate=COUNT   warn above COUNT forks per "
+                  "second\n");
+  fprintf(stream, "      --cgroup-env              export CPU and memory sizing "
+                  "from cgroup limits\n");
+  fprintf(stream, "      --cpu-rounding=POLICY     round CPU quota (floor, ceil, "
+                  "nearest; default: ceil)\n");
+  fprintf(stream, "      --harden                  lock memory, lower "
+                  "oom_score_adj and raise priority\n");
+  fprintf(stream, "      --oom-score-adj=ADJ       oom_score_adj for --harden "
+                  "(default: -1000)\n");
+  fprintf(stream, "      --nice=NICE               nice value for --harden "
+                  "(default: -10)\n");
+  fprintf(stream, "      --prewarm                 read ahead COMMAND and its "
+                  "shared libraries\n");
+  fprintf(stream, "      --prewarm-list=FILE       also read ahead the files "
+                  "listed in FILE\n");
+  fprintf(stream, "      --watchdog=SECONDS        expect a heartbeat from "
+                  "COMMAND every SECONDS\n");
+  fprintf(stream, "      --watchdog-signal=SIGNAL  first signal on a missed "
+                  "heartbeat (default: QUIT)\n");
+  fprintf(stream, "      --watchdog-grace=SECONDS  wait before SIGKILL "
+                  "(default: 5)\n");
+  fprintf(stream, "      --watchdog-action=ACTION  after SIGKILL: exit or "
+                  "restart (default: exit)\n");
+  fprintf(stream, "      --forward=MODE            forward signals to the "
+                  "child, its group or session\n");
+  fprintf(stream, "      --forward-all             forward every catchable "
+                  "signal\n");
+  fprintf(stream, "      --signal-rewrite=FROM:TO[,FROM:TO]... forward FROM "
+                  "as TO (NONE drops)\n");
+  fprintf(stream, "      --jobs=FILE|-             run each record of FILE as "
+                  "a job (see --parallel)\n");
+  fprintf(stream, "      --parallel=COUNT          run up to COUNT jobs at once "
+                  "(default: CPUs)\n");
+  fprintf(stream, "      --null                    job records are separated "
+                  "by NUL, not newline\n");
+  fprintf(stream, "      --fail-fast               stop and terminate jobs "
+                  "after the first failure\n");
+  fprintf(stream, "      --keep-going              run every job despite "
+                  "failures (default)\n");
+  fprintf(stream, "      --job-log=FILE            write job results to FILE "
+                  "(default: stderr)\n");
+  fprintf(stream, "      --timeout=DURATION        signal a child still running "
+                  "after DURATION\n");
+  fprintf(stream, "      --timeout-signal=SIGNAL   signal on timeout "
+                  "(default: TERM)\n");
+  fprintf(stream, "      --kill-after=DURATION     send SIGKILL if still running "
+                  "DURATION later\n");
+  fprintf(stream, "      --timeout-tree            also signal the child's "
+                  "descendants (tracks the tree)\n");
+  fprintf(stream, "      --cpu-limit=DURATION      limit the CPU time of each "
+                  "process with RLIMIT_CPU\n");
   fprintf(stream, "  -v, --verbose                 verbose mode\n");
   fprintf(stream, "  -q, --quiet                   quiet mode\n");
   fprintf(stream, "  -V, --version                 display version and exit\n");
@@ -120,6 +367,42 @@ void iexec_option_parse(int argc, char **argv, struct iexec_option *ctx) {
   static struct option long_options[] = {
       {"allow-privileged-pidns", no_argument, NULL, 256},
       {"deathsig", required_argument, NULL, 'k'},
+      {"reload", optional_argument, NULL, 257},
+      {"reload-timeout", required_argument, NULL, 258},
+      {"reload-stop-signal", required_argument, NULL, 259},
+      {"journal", required_argument, NULL, 260},
+      {"journal-records", required_argument, NULL, 261},
+      {"control-socket", required_argument, NULL, 262},
+      {"attach", required_argument, NULL, 263},
+      {"stats", required_argument, NULL, 264},
+      {"track-tree", optional_argument, NULL, 265},
+      {"track-interval", required_argument, NULL, 266},
+      {"fork-storm-rate", required_argument, NULL, 267},
+      {"cgroup-env", no_argument, NULL, 268},
+      {"cpu-rounding", required_argument, NULL, 269},
+      {"harden", no_argument, NULL, 270},
+      {"oom-score-adj", required_argument, NULL, 271},
+      {"nice", required_argument, NULL, 272},
+      {"prewarm", no_argument, NULL, 273},
+      {"prewarm-list", required_argument, NULL, 274},
+      {"watchdog", required_argument, NULL, 275},
+      {"watchdog-signal", required_argument, NULL, 276},
+      {"watchdog-grace", required_argument, NULL, 277},
+      {"watchdog-action", required_argument, NULL, 278},
+      {"forward", required_argument, NULL, 279},
+      {"forward-all", no_argument, NULL, 280},
+      {"signal-rewrite", required_argument, NULL, 281},
+      {"jobs", required_argument, NULL, 282},
+      {"parallel", required_argument, NULL, 283},
+      {"null", no_argument, NULL, 284},
+      {"fail-fast", no_argument, NULL, 285},
+      {"keep-going", no_argument, NULL, 286},
+      {"job-log", required_argument, NULL, 287},
+      {"timeout", required_argument, NULL, 288},
+      {"timeout-signal", required_argument, NULL, 289},
+      {"kill-after", required_argument, NULL, 290},
+      {"timeout-tree", no_argument, NULL, 291},
+      {"cpu-limit", required_argument, NULL, 292},
       {"pidns", optional_argument, NULL, 'p'},
       {"verbose", no_argument, NULL, 'v'},
       {"quiet", no_argument, NULL, 'q'},
@@ -134,6 +417,236 @@ void iexec_option_parse(int argc, char **argv, struct iexec_option *ctx) {
       ctx->allow_privileged_pidns = 1;
       break;
 
+    case 257:
+      ctx->reload_signal =
+          optarg == NULL ? SIGHUP : iexec_option_parse_signal(optarg);
+      if (ctx->reload_signal <= 0) {
+        fprintf(stderr, "Invalid signal: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 258:
+      ctx->reload_timeout = iexec_option_parse_uint(optarg);
+      if (ctx->reload_timeout == -1) {
+        fprintf(stderr, "Invalid timeout: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 259:
+      ctx->reload_stop_signal = iexec_option_parse_signal(optarg);
+      if (ctx->reload_stop_signal <= 0) {
+        fprintf(stderr, "Invalid signal: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 260:
+      ctx->journal_path = optarg;
+      break;
+
+    case 261:
+      ctx->journal_records = iexec_option_parse_uint(optarg);
+      if (ctx->journal_records <= 0) {
+        fprintf(stderr, "Invalid journal records: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 262:
+      ctx->control_path = optarg;
+      break;
+
+    case 263:
+      ctx->attach_path = optarg;
+      break;
+
+    case 264:
+      ctx->stats_path = optarg;
+      break;
+
+    case 265:
+      if (iexec_option_parse_proctree_mode(optarg, ctx) == -1) {
+        fprintf(stderr, "Invalid track-tree mode: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 266:
+      ctx->proctree_interval = iexec_option_parse_uint(optarg);
+      if (ctx->proctree_interval <= 0) {
+        fprintf(stderr, "Invalid interval: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 267:
+      ctx->fork_storm_rate = iexec_option_parse_uint(optarg);
+      if (ctx->fork_storm_rate == -1) {
+        fprintf(stderr, "Invalid rate: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 268:
+      ctx->cgroup_env = 1;
+      break;
+
+    case 269:
+      if (iexec_option_parse_cpu_rounding(optarg, ctx) == -1) {
+        fprintf(stderr, "Invalid cpu rounding: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 270:
+      ctx->harden = 1;
+      break;
+
+    case 271:
+      if (iexec_option_parse_int(optarg, -1000, 1000, &ctx->oom_score_adj) ==
+          -1) {
+        fprintf(stderr, "Invalid oom_score_adj: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      ctx->harden = 1;
+      break;
+
+    case 272:
+      if (iexec_option_parse_int(optarg, -20, 19, &ctx->nice) == -1) {
+        fprintf(stderr, "Invalid nice value: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      ctx->harden = 1;
+      break;
+
+    case 273:
+      ctx->prewarm = 1;
+      break;
+
+    case 274:
+      ctx->prewarm_list = optarg;
+      ctx->prewarm = 1;
+      break;
+
+    case 275:
+      ctx->watchdog_interval = iexec_option_parse_uint(optarg);
+      if (ctx->watchdog_interval <= 0) {
+        fprintf(stderr, "Invalid interval: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 276:
+      ctx->watchdog_signal = iexec_option_parse_signal(optarg);
+      if (ctx->watchdog_signal == -1) {
+        fprintf(stderr, "Invalid signal: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 277:
+      ctx->watchdog_grace = iexec_option_parse_uint(optarg);
+      if (ctx->watchdog_grace <= 0) {
+        fprintf(stderr, "Invalid grace period: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 278:
+      if (strcasecmp(optarg, "exit") == 0) {
+        ctx->watchdog_restart = 0;
+      } else if (strcasecmp(optarg, "restart") == 0) {
+        ctx->watchdog_restart = 1;
+      } else {
+        fprintf(stderr, "Invalid watchdog action: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 279:
+      if (iexec_option_parse_forward_mode(optarg, ctx) == -1) {
+        fprintf(stderr, "Invalid forward mode: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 280:
+      ctx->forward_all = 1;
+      break;
+
+    case 281:
+      if (iexec_option_parse_signal_rewrite(optarg, ctx) == -1) {
+        fprintf(stderr, "Invalid signal rewrite: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 282:
+      ctx->jobs_path = optarg;
+      break;
+
+    case 283:
+      if (iexec_option_parse_int(optarg, 1, IEXEC_OPTION_MAX_PARALLEL,
+                                 &ctx->jobs_parallel) == -1) {
+        fprintf(stderr, "Invalid parallelism: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 284:
+      ctx->jobs_null = 1;
+      break;
+
+    case 285:
+      ctx->jobs_fail_fast = 1;
+      break;
+
+    case 286:
+      ctx->jobs_fail_fast = 0;
+      break;
+
+    case 287:
+      ctx->jobs_log = optarg;
+      break;
+
+    case 288:
+      if (iexec_option_parse_duration(optarg, &ctx->timeout_ms) == -1) {
+        fprintf(stderr, "Invalid duration: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 289:
+      ctx->timeout_signal = iexec_option_parse_signal(optarg);
+      if (ctx->timeout_signal <= 0) {
+        fprintf(stderr, "Invalid signal: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 290:
+      if (iexec_option_parse_duration(optarg, &ctx->kill_after_ms) == -1) {
+        fprintf(stderr, "Invalid duration: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
+    case 291:
+      ctx->timeout_tree = 1;
+      if (ctx->proctree == IEXEC_PROCTREE_MODE_OFF) {
+        ctx->proctree = IEXEC_PROCTREE_MODE_AUTO;
+      }
+      break;
+
+    case 292:
+      if (iexec_option_parse_duration(optarg, &ctx->cpu_limit_ms) == -1) {
+        fprintf(stderr, "Invalid duration: %s\n", optarg);
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      break;
+
     case 'k':
       ctx->deathsig = iexec_option_parse_signal(optarg);
       if (ctx->deathsig == -1) {
@@ -170,6 +683,14 @@ void iexec_option_parse(int argc, char **argv, struct iexec_option *ctx) {
       iexec_exit(IEXEC_EXIT_FAILURE);
     }
   }
+  // the reload signal is kept by iexec, so it cannot be rewritten either
+  if (ctx->reload_signal != 0 &&
+      ctx->signal_rewrite[ctx->reload_signal] != ctx->reload_signal) {
+    const char *name = sigabbrev_np(ctx->reload_signal);
+    fprintf(stderr, "Invalid signal rewrite: SIG%s is the reload signal\n",
+            name != NULL ? name : "RT");
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
   ctx->envind = optind;
 }
 
@@ -180,6 +701,43 @@ void iexec_option_init(struct iexec_option *ctx) {
   ctx->pidns_filename = NULL;
   ctx->pidns_fd = 0;
   ctx->allow_privileged_pidns = 0;
+  ctx->reload_signal = 0;
+  ctx->reload_stop_signal = SIGTERM;
+  ctx->reload_timeout = 10;
+  ctx->journal_path = NULL;
+  ctx->journal_records = IEXEC_JOURNAL_DEFAULT_RECORDS;
+  ctx->control_path = NULL;
+  ctx->attach_path = NULL;
+  ctx->stats_path = NULL;
+  ctx->proctree = IEXEC_PROCTREE_MODE_OFF;
+  ctx->proctree_interval = 1;
+  ctx->fork_storm_rate = 0;
+  ctx->cgroup_env = 0;
+  ctx->cpu_rounding = IEXEC_CPU_ROUNDING_CEIL;
+  ctx->harden = 0;
+  ctx->oom_score_adj = -1000;
+  ctx->nice = -10;
+  ctx->prewarm = 0;
+  ctx->prewarm_list = NULL;
+  ctx->watchdog_interval = 0;
+  ctx->watchdog_signal = SIGQUIT;
+  ctx->watchdog_grace = 5;
+  ctx->watchdog_restart = 0;
+  ctx->forward = IEXEC_FORWARD_MODE_CHILD;
+  ctx->forward_all = 0;
+  for (int signum = 0; signum < NSIG; signum++) {
+    ctx->signal_rewrite[signum] = signum;
+  }
+  ctx->jobs_path = NULL;
+  ctx->jobs_null = 0;
+  ctx->jobs_parallel = 0;
+  ctx->jobs_fail_fast = 0;
+  ctx->jobs_log = NULL;
+  ctx->timeout_ms = 0;
+  ctx->kill_after_ms = 0;
+  ctx->timeout_signal = SIGTERM;
+  ctx->timeout_tree = 0;
+  ctx->cpu_limit_ms = 0;
   ctx->envind = 0;
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "iexec.h"
+#include <signal.h>
 #include <stdio.h>
 #include <sys/types.h>
 
@@ -12,6 +13,25 @@ typedef enum iexec_pidns_mode {
   IEXEC_PIDNS_MODE_ENTER_BY_FD
 } iexec_pidns_mode_t;
 
+typedef enum iexec_proctree_mode {
+  IEXEC_PROCTREE_MODE_OFF,
+  IEXEC_PROCTREE_MODE_AUTO,
+  IEXEC_PROCTREE_MODE_NETLINK,
+  IEXEC_PROCTREE_MODE_PROC
+} iexec_proctree_mode_t;
+
+typedef enum iexec_cpu_rounding {
+  IEXEC_CPU_ROUNDING_FLOOR,
+  IEXEC_CPU_ROUNDING_CEIL,
+  IEXEC_CPU_ROUNDING_NEAREST
+} iexec_cpu_rounding_t;
+
+typedef enum iexec_forward_mode {
+  IEXEC_FORWARD_MODE_CHILD,
+  IEXEC_FORWARD_MODE_GROUP,
+  IEXEC_FORWARD_MODE_SESSION
+} iexec_forward_mode_t;
+
 typedef struct iexec_option {
   int deathsig;
   iexec_pidns_mode_t pidns;
@@ -19,6 +39,41 @@ typedef struct iexec_option {
   const char *pidns_filename;
   int pidns_fd;
   int allow_privileged_pidns;
+  int reload_signal;
+  int reload_stop_signal;
+  int reload_timeout;
+  const char *journal_path;
+  int journal_records;
+  const char *control_path;
+  const char *attach_path;
+  const char *stats_path;
+  iexec_proctree_mode_t proctree;
+  int proctree_interval;
+  int fork_storm_rate;
+  int cgroup_env;
+  iexec_cpu_rounding_t cpu_rounding;
+  int harden;
+  int oom_score_adj;
+  int nice;
+  int prewarm;
+  const char *prewarm_list;
+  int watchdog_interval;
+  int watchdog_signal;
+  int watchdog_grace;
+  int watchdog_restart;
+  iexec_forward_mode_t forward;
+  int forward_all;
+  int signal_rewrite[NSIG];
+  const char *jobs_path;
+  int jobs_null;
+  int jobs_parallel;
+  int jobs_fail_fast;
+  const char *jobs_log;
+  long long timeout_ms;
+  long long kill_after_ms;
+  int timeout_signal;
+  int timeout_tree;
+  long long cpu_limit_ms;
   int envind;
 } iexec_option_t;
 
@@ -0,0 +1,603 @@
+#include "iexec_prewarm.h"
+#include "iexec_print.h"
+#include "iexec_process.h"
+#include <elf.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define IEXEC_PREWARM_MAX_FILES 512
+#define IEXEC_PREWARM_MAX_DEPTH 16
+#define IEXEC_PREWARM_MAX_PHDRS 64
+#define IEXEC_PREWARM_MAX_DYNAMIC 256
+#define IEXEC_PREWARM_MAX_NEEDED 128
+#define IEXEC_PREWARM_MAX_SCRIPTS 4
+#define IEXEC_PREWARM_DEFAULT_PATH "/bin:/usr/bin"
+#define IEXEC_PREWARM_DEFAULT_LIBRARY_PATH "/lib64:/usr/lib64:/lib:/usr/lib"
+#define IEXEC_PREWARM_CACHE "/etc/ld.so.cache"
+#define IEXEC_PREWARM_CACHE_MAGIC "glibc-ld.so.cache1.1"
+#define IEXEC_PREWARM_CACHE_OLD_MAGIC "ld.so-1.7.0"
+
+typedef struct iexec_prewarm_file {
+  dev_t dev;
+  ino_t ino;
+} iexec_prewarm_file_t;
+
+// object properties a library must share with the executable to be loadable
+typedef struct iexec_prewarm_elf {
+  unsigned char elf_class;
+  uint16_t machine;
+} iexec_prewarm_elf_t;
+
+typedef struct iexec_prewarm_cache_header {
+  char magic[20];
+  uint32_t nlibs;
+  uint32_t len_strings;
+  uint8_t flags;
+  uint8_t padding[3];
+  uint32_t extension_offset;
+  uint32_t unused[3];
+} iexec_prewarm_cache_header_t;
+
+typedef struct iexec_prewarm_cache_entry {
+  int32_t flags;
+  uint32_t key;
+  uint32_t value;
+  uint32_t osversion;
+  uint64_t hwcap;
+} iexec_prewarm_cache_entry_t;
+
+static iexec_prewarm_file_t iexec_prewarm_files[IEXEC_PREWARM_MAX_FILES];
+static size_t iexec_prewarm_count = 0;
+static unsigned long long iexec_prewarm_bytes = 0;
+static iexec_prewarm_elf_t iexec_prewarm_target;
+static const char *iexec_prewarm_library_path = NULL;
+static const char *iexec_prewarm_cache = NULL;
+static size_t iexec_prewarm_cache_size = 0;
+static char iexec_prewarm_interp_dir[PATH_MAX];
+
+/**
+ * Open a file and advise readahead of its contents once.
+ *
+ * @return the open descriptor, or -1 if it cannot be opened or was already
+ * warmed
+ */
+static int iexec_prewarm_open(const char *path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return -1;
+  }
+  for (size_t i = 0; i < iexec_prewarm_count; i++) {
+    if (iexec_prewarm_files[i].dev == st.st_dev &&
+        iexec_prewarm_files[i].ino == st.st_ino) {
+      close(fd);
+      return -1;
+    }
+  }
+  if (iexec_prewarm_count == IEXEC_PREWARM_MAX_FILES) {
+    close(fd);
+    return -1;
+  }
+  iexec_prewarm_files[iexec_prewarm_count].dev = st.st_dev;
+  iexec_prewarm_files[iexec_prewarm_count].ino = st.st_ino;
+  iexec_prewarm_count++;
+  if (posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED) == 0) {
+    iexec_prewarm_bytes += (unsigned long long)st.st_size;
+  }
+  iexec_printf(IEXEC_PRINT_LEVEL_DEBUG, "prewarm %s\n", path);
+  return fd;
+}
+
+static int iexec_prewarm_read(int fd, void *buf, size_t size, uint64_t offset) {
+  if (offset > (uint64_t)LLONG_MAX) {
+    return -1;
+  }
+  return pread(fd, buf, size, (off_t)offset) == (ssize_t)size ? 0 : -1;
+}
+
+static int iexec_prewarm_read_string(int fd, char *buf, size_t size,
+                                     uint64_t offset) {
+  if (offset > (uint64_t)LLONG_MAX) {
+    return -1;
+  }
+  ssize_t len = pread(fd, buf, size - 1, (off_t)offset);
+  if (len <= 0) {
+    return -1;
+  }
+  buf[len] = '\0';
+  return strlen(buf) < (size_t)len ? 0 : -1;
+}
+
+/**
+ * Program and dynamic section entries, widened from either ELF class.
+ */
+typedef struct iexec_prewarm_phdr {
+  uint32_t type;
+  uint64_t offset;
+  uint64_t vaddr;
+  uint64_t filesz;
+} iexec_prewarm_phdr_t;
+
+static int iexec_prewarm_read_header(int fd, iexec_prewarm_elf_t *elf,
+                                     iexec_prewarm_phdr_t *phdrs,
+                                     size_t *count) {
+  Elf64_Ehdr ehdr;
+  if (pread(fd, &ehdr, sizeof(ehdr), 0) < (ssize_t)sizeof(Elf32_Ehdr) ||
+      memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0) {
+    return -1;
+  }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  if (ehdr.e_ident[EI_DATA] != ELFDATA2LSB) {
+    return -1;
+  }
+#else
+  if (ehdr.e_ident[EI_DATA] != ELFDATA2MSB) {
+    return -1;
+  }
+#endif
+  elf->elf_class = ehdr.e_ident[EI_CLASS];
+  elf->machine = ehdr.e_machine;
+
+  if (elf->elf_class == ELFCLASS64) {
+    if (ehdr.e_phnum > IEXEC_PREWARM_MAX_PHDRS ||
+        ehdr.e_phentsize != sizeof(Elf64_Phdr)) {
+      return -1;
+    }
+    Elf64_Phdr raw[IEXEC_PREWARM_MAX_PHDRS];
+    if (iexec_prewarm_read(fd, raw, sizeof(Elf64_Phdr) * ehdr.e_phnum,
+                           ehdr.e_phoff) == -1) {
+      return -1;
+    }
+    for (size_t i = 0; i < ehdr.e_phnum; i++) {
+      phdrs[i].type = raw[i].p_type;
+      phdrs[i].offset = raw[i].p_offset;
+      phdrs[i].vaddr = raw[i].p_vaddr;
+      phdrs[i].filesz = raw[i].p_filesz;
+    }
+    *count = ehdr.e_phnum;
+    return 0;
+  }
+  if (elf->elf_class == ELFCLASS32) {
+    Elf32_Ehdr ehdr32;
+    memcpy(&ehdr32, &ehdr, sizeof(ehdr32));
+    if (ehdr32.e_phnum > IEXEC_PREWARM_MAX_PHDRS ||
+        ehdr32.e_phentsize != sizeof(Elf32_Phdr)) {
+      return -1;
+    }
+    Elf32_Phdr raw[IEXEC_PREWARM_MAX_PHDRS];
+    if (iexec_prewarm_read(fd, raw, sizeof(Elf32_Phdr) * ehdr32.e_phnum,
+                           ehdr32.e_phoff) == -1) {
+      return -1;
+    }
+    for (size_t i = 0; i < ehdr32.e_phnum; i++) {
+      phdrs[i].type = raw[i].p_type;
+      phdrs[i].offset = raw[i].p_offset;
+      phdrs[i].vaddr = raw[i].p_vaddr;
+      phdrs[i].filesz = raw[i].p_filesz;
+    }
+    *count = ehdr32.e_phnum;
+    return 0;
+  }
+  return -1;
+}
+
+static int iexec_prewarm_read_dynamic(int fd, unsigned char elf_class,
+                                      const iexec_prewarm_phdr_t *dynamic,
+                                      int64_t *tags, uint64_t *values,
+                                      size_t *count) {
+  size_t entsize = elf_class == ELFCLASS64 ? sizeof(Elf64_Dyn)
+                                           : sizeof(Elf32_Dyn);
+  size_t n = dynamic->filesz / entsize;
+  if (n > IEXEC_PREWARM_MAX_DYNAMIC) {
+    n = IEXEC_PREWARM_MAX_DYNAMIC;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (elf_class == ELFCLASS64) {
+      Elf64_Dyn dyn;
+      if (iexec_prewarm_read(fd, &dyn, sizeof(dyn),
+                             dynamic->offset + i * entsize) == -1) {
+        return -1;
+      }
+      tags[i] = dyn.d_tag;
+      values[i] = dyn.d_un.d_val;
+    } else {
+      Elf32_Dyn dyn;
+      if (iexec_prewarm_read(fd, &dyn, sizeof(dyn),
+                             dynamic->offset + i * entsize) == -1) {
+        return -1;
+      }
+      tags[i] = dyn.d_tag;
+      values[i] = dyn.d_un.d_val;
+    }
+    if (tags[i] == DT_NULL) {
+      n = i;
+      break;
+    }
+  }
+  *count = n;
+  return 0;
+}
+
+static int iexec_prewarm_vaddr_to_offset(const iexec_prewarm_phdr_t *phdrs,
+                                         size_t count, uint64_t vaddr,
+                                         uint64_t *offset) {
+  for (size_t i = 0; i < count; i++) {
+    if (phdrs[i].type == PT_LOAD && phdrs[i].vaddr <= vaddr &&
+        vaddr - phdrs[i].vaddr < phdrs[i].filesz) {
+      *offset = vaddr - phdrs[i].vaddr + phdrs[i].offset;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static int iexec_prewarm_matches(int fd) {
+  iexec_prewarm_elf_t elf;
+  iexec_prewarm_phdr_t phdrs[IEXEC_PREWARM_MAX_PHDRS];
+  size_t count;
+  return iexec_prewarm_read_header(fd, &elf, phdrs, &count) == 0 &&
+         elf.elf_class == iexec_prewarm_target.elf_class &&
+         elf.machine == iexec_prewarm_target.machine;
+}
+
+static void iexec_prewarm_elf(int fd, const char *path, int depth);
+
+/**
+ * Warm a library candidate if it is loadable by the executable.
+ *
+ * @return non-zero when the candidate matched (even if already warmed)
+ */
+static int iexec_prewarm_try(const char *path, int depth) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return 0;
+  }
+  int matches = iexec_prewarm_matches(fd);
+  close(fd);
+  if (!matches) {
+    return 0;
+  }
+  fd = iexec_prewarm_open(path);
+  if (fd != -1) {
+    iexec_prewarm_elf(fd, path, depth);
+    close(fd);
+  }
+  return 1;
+}
+
+/**
+ * Look a library up in a colon separated search list.
+ *
+ * @return non-zero when the library was found
+ */
+static int iexec_prewarm_search(const char *name, const char *list,
+                                const char *origin, int depth) {
+  char path[PATH_MAX];
+  while (list != NULL && *list != '\0') {
+    const char *end = strchrnul(list, ':');
+    int len = (int)(end - list);
+    int written;
+    if (len == 0) {
+      written = snprintf(path, sizeof(path), "./%s", name);
+    } else if (strncmp(list, "$ORIGIN", 7) == 0 && origin != NULL) {
+      written = snprintf(path, sizeof(path), "%s%.*s/%s", origin, len - 7,
+                         list + 7, name);
+    } else {
+      written = snprintf(path, sizeof(path), "%.*s/%s", len, list, name);
+    }
+    list = *end == ':' ? end + 1 : end;
+    if (written >= 0 && (size_t)written < sizeof(path) &&
+        iexec_prewarm_try(path, depth)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static const iexec_prewarm_cache_header_t *iexec_prewarm_cache_header(void) {
+  const char *base = iexec_prewarm_cache;
+  size_t size = iexec_prewarm_cache_size;
+  size_t offset = 0;
+  if (size >= 16 &&
+      memcmp(base, IEXEC_PREWARM_CACHE_OLD_MAGIC,
+             strlen(IEXEC_PREWARM_CACHE_OLD_MAGIC)) == 0) {
+    // the new format follows the old one, 8-byte aligned
+    uint32_t nlibs;
+    memcpy(&nlibs, base + 12, sizeof(nlibs));
+    offset = (16 + (size_t)nlibs * 12 + 7) & ~(size_t)7;
+  }
+  if (offset + sizeof(iexec_prewarm_cache_header_t) > size ||
+      memcmp(base + offset, IEXEC_PREWARM_CACHE_MAGIC,
+             strlen(IEXEC_PREWARM_CACHE_MAGIC)) != 0) {
+    return NULL;
+  }
+  return (const iexec_prewarm_cache_header_t *)(base + offset);
+}
+
+static int iexec_prewarm_search_cache(const char *name, int depth) {
+  const iexec_prewarm_cache_header_t *header;
+  if (iexec_prewarm_cache == NULL ||
+      (header = iexec_prewarm_cache_header()) == NULL) {
+    return 0;
+  }
+  const char *strings = (const char *)header;
+  size_t limit = iexec_prewarm_cache_size -
+                 (size_t)(strings - iexec_prewarm_cache);
+  const iexec_prewarm_cache_entry_t *entries =
+      (const iexec_prewarm_cache_entry_t *)(header + 1);
+  if (header->nlibs > (limit - sizeof(*header)) / sizeof(*entries)) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < header->nlibs; i++) {
+    const iexec_prewarm_cache_entry_t *entry = &entries[i];
+    if (entry->key >= limit || entry->value >= limit ||
+        strnlen(strings + entry->key, limit - entry->key) ==
+            limit - entry->key ||
+        strnlen(strings + entry->value, limit - entry->value) ==
+            limit - entry->value ||
+        strcmp(strings + entry->key, name) != 0) {
+      continue;
+    }
+    // the cache may list several architectures under the same name
+    if (iexec_prewarm_try(strings + entry->value, depth)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void iexec_prewarm_needed(const char *name, const char *rpath,
+                                 const char *runpath, const char *origin,
+                                 int depth) {
+  if (strchr(name, '/') != NULL) {
+    int fd = iexec_prewarm_open(name);
+    if (fd != -1) {
+      iexec_prewarm_elf(fd, name, depth);
+      close(fd);
+    }
+    return;
+  }
+  // same order as the dynamic loader; DT_RPATH is ignored with DT_RUNPATH
+  if (runpath == NULL && iexec_prewarm_search(name, rpath, origin, depth)) {
+    return;
+  }
+  if (iexec_prewarm_search(name, iexec_prewarm_library_path, origin, depth) ||
+      iexec_prewarm_search(name, runpath, origin, depth) ||
+      iexec_prewarm_search_cache(name, depth) ||
+      iexec_prewarm_search(name, iexec_prewarm_interp_dir, NULL, depth) ||
+      iexec_prewarm_search(name, IEXEC_PREWARM_DEFAULT_LIBRARY_PATH, NULL,
+                           depth)) {
+    return;
+  }
+  iexec_printf(IEXEC_PRINT_LEVEL_DEBUG, "prewarm: %s not found\n", name);
+}
+
+static void iexec_prewarm_elf(int fd, const char *path, int depth) {
+  iexec_prewarm_elf_t elf;
+  iexec_prewarm_phdr_t phdrs[IEXEC_PREWARM_MAX_PHDRS];
+  size_t count;
+  if (depth >= IEXEC_PREWARM_MAX_DEPTH ||
+      iexec_prewarm_read_header(fd, &elf, phdrs, &count) == -1) {
+    return;
+  }
+  if (depth == 0) {
+    iexec_prewarm_target = elf;
+  }
+
+  const iexec_prewarm_phdr_t *dynamic = NULL;
+  for (size_t i = 0; i < count; i++) {
+    if (phdrs[i].type == PT_INTERP) {
+      char interp[PATH_MAX];
+      if (phdrs[i].filesz < sizeof(interp) &&
+          iexec_prewarm_read_string(fd, interp, phdrs[i].filesz + 1,
+                                    phdrs[i].offset) == 0) {
+        snprintf(iexec_prewarm_interp_dir, sizeof(iexec_prewarm_interp_dir),
+                 "%s", interp);
+        char *slash = strrchr(iexec_prewarm_interp_dir, '/');
+        if (slash != NULL) {
+          *slash = '\0';
+        }
+        int interp_fd = iexec_prewarm_open(interp);
+        if (interp_fd != -1) {
+          close(interp_fd);
+        }
+      }
+    } else if (phdrs[i].type == PT_DYNAMIC) {
+      dynamic = &phdrs[i];
+    }
+  }
+  if (dynamic == NULL) {
+    return;
+  }
+
+  int64_t tags[IEXEC_PREWARM_MAX_DYNAMIC];
+  uint64_t values[IEXEC_PREWARM_MAX_DYNAMIC];
+  size_t ndyn;
+  if (iexec_prewarm_read_dynamic(fd, elf.elf_class, dynamic, tags, values,
+                                 &ndyn) == -1) {
+    return;
+  }
+  uint64_t strtab = 0;
+  int has_strtab = 0;
+  for (size_t i = 0; i < ndyn; i++) {
+    if (tags[i] == DT_STRTAB) {
+      has_strtab =
+          iexec_prewarm_vaddr_to_offset(phdrs, count, values[i], &strtab) == 0;
+    }
+  }
+  if (!has_strtab) {
+    return;
+  }
+
+  char rpath[PATH_MAX];
+  char runpath[PATH_MAX];
+  int has_rpath = 0;
+  int has_runpath = 0;
+  uint64_t needed[IEXEC_PREWARM_MAX_NEEDED];
+  size_t nneeded = 0;
+  for (size_t i = 0; i < ndyn; i++) {
+    if (tags[i] == DT_RPATH) {
+      has_rpath = iexec_prewarm_read_string(fd, rpath, sizeof(rpath),
+                                            strtab + values[i]) == 0;
+    } else if (tags[i] == DT_RUNPATH) {
+      has_runpath = iexec_prewarm_read_string(fd, runpath, sizeof(runpath),
+                                              strtab + values[i]) == 0;
+    } else if (tags[i] == DT_NEEDED && nneeded < IEXEC_PREWARM_MAX_NEEDED) {
+      needed[nneeded++] = values[i];
+    }
+  }
+
+  char origin[PATH_MAX];
+  snprintf(origin, sizeof(origin), "%s", path);
+  char *slash = strrchr(origin, '/');
+  if (slash != NULL) {
+    *slash = '\0';
+  } else {
+    snprintf(origin, sizeof(origin), ".");
+  }
+  for (size_t i = 0; i < nneeded; i++) {
+    char name[NAME_MAX + 1];
+    if (iexec_prewarm_read_string(fd, name, sizeof(name),
+                                  strtab + needed[i]) == 0) {
+      iexec_prewarm_needed(name, has_rpath ? rpath : NULL,
+                           has_runpath ? runpath : NULL, origin, depth + 1);
+    }
+  }
+}
+
+// scripts are followed to their "#!" interpreter, as execve does
+static void iexec_prewarm_executable(const char *path, int scripts) {
+  char line[PATH_MAX];
+  int fd = iexec_prewarm_open(path);
+  if (fd == -1) {
+    return;
+  }
+  ssize_t len = pread(fd, line, sizeof(line) - 1, 0);
+  if (len > 2 && line[0] == '#' && line[1] == '!') {
+    close(fd);
+    line[len] = '\0';
+    char *interp = line + 2 + strspn(line + 2, " \t");
+    interp[strcspn(interp, " \t\n")] = '\0';
+    if (*interp != '\0' && scripts < IEXEC_PREWARM_MAX_SCRIPTS) {
+      iexec_prewarm_executable(interp, scripts + 1);
+    }
+    return;
+  }
+  iexec_prewarm_elf(fd, path, 0);
+  close(fd);
+}
+
+static const char *iexec_prewarm_getenv(int argc, char **argv,
+                                        const char *name) {
+  size_t len = strlen(name);
+  // a leading NAME=value assignment wins, as it does for the child
+  for (int i = argc - 1; i >= 0; i--) {
+    if (strncmp(argv[i], name, len) == 0 && argv[i][len] == '=') {
+      return argv[i] + len + 1;
+    }
+  }
+  return iexec_getenv(name);
+}
+
+static int iexec_prewarm_resolve(const char *file, const char *search,
+                                 char *path, size_t size) {
+  if (strchr(file, '/') != NULL) {
+    snprintf(path, size, "%s", file);
+    return 0;
+  }
+  while (search != NULL) {
+    const char *end = strchrnul(search, ':');
+    int len = (int)(end - search);
+    int written = len == 0 ? snprintf(path, size, "%s", file)
+                           : snprintf(path, size, "%.*s/%s", len, search, file);
+    struct stat st;
+    if (written >= 0 && (size_t)written < size && stat(path, &st) == 0 &&
+        S_ISREG(st.st_mode) && access(path, X_OK) == 0) {
+      return 0;
+    }
+    search = *end == ':' ? end + 1 : NULL;
+  }
+  return -1;
+}
+
+static void iexec_prewarm_list(const char *list) {
+  char line[PATH_MAX];
+  FILE *fp = fopen(list, "re");
+  if (fp == NULL) {
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "Warning: prewarm list %s: %s\n",
+                 list, iexec_strerror(iexec_errno()));
+    return;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    line[strcspn(line, "\n")] = '\0';
+    if (line[0] == '\0' || line[0] == '#') {
+      continue;
+    }
+    int fd = iexec_prewarm_open(line);
+    if (fd == -1) {
+      iexec_printf(IEXEC_PRINT_LEVEL_INFORMATION, "prewarm: skip %s\n", line);
+      continue;
+    }
+    close(fd);
+  }
+  fclose(fp);
+}
+
+static void iexec_prewarm_map_cache(void) {
+  int fd = open(IEXEC_PREWARM_CACHE, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      iexec_prewarm_cache = map;
+      iexec_prewarm_cache_size = (size_t)st.st_size;
+    }
+  }
+  close(fd);
+}
+
+void iexec_prewarm(const iexec_option_t *ctx, int argc, char **argv,
+                   int cmdind) {
+  char path[PATH_MAX];
+  if (!ctx->prewarm) {
+    return;
+  }
+  const char *search = iexec_prewarm_getenv(cmdind, argv, "PATH");
+  iexec_prewarm_library_path =
+      iexec_prewarm_getenv(cmdind, argv, "LD_LIBRARY_PATH");
+  if (cmdind < argc &&
+      iexec_prewarm_resolve(argv[cmdind],
+                            search != NULL ? search
+                                           : IEXEC_PREWARM_DEFAULT_PATH,
+                            path, sizeof(path)) == 0) {
+    iexec_prewarm_map_cache();
+    iexec_prewarm_executable(path, 0);
+    if (iexec_prewarm_cache != NULL) {
+      munmap((void *)iexec_prewarm_cache, iexec_prewarm_cache_size);
+      iexec_prewarm_cache = NULL;
+    }
+  } else if (cmdind < argc) {
+    iexec_printf(IEXEC_PRINT_LEVEL_INFORMATION, "prewarm: %s not found\n",
+                 argv[cmdind]);
+  }
+  if (ctx->prewarm_list != NULL) {
+    iexec_prewarm_list(ctx->prewarm_list);
+  }
+  iexec_printf(IEXEC_PRINT_LEVEL_INFORMATION,
+               "prewarm: %zu files, %llu bytes\n", iexec_prewarm_count,
+               iexec_prewarm_bytes);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "iexec.h"
+#include "iexec_option.h"
+
+/**
+ * @brief Prefetch the command, its ELF interpreter and shared libraries
+ *
+ * The command is resolved like execvp, honouring a PATH given as a leading
+ * NAME=value assignment, and scripts are followed to their interpreter.
+ * PT_INTERP and DT_NEEDED entries are followed recursively, and every file
+ * found, plus those listed in the prewarm list file, gets
+ * posix_fadvise(POSIX_FADV_WILLNEED). The advice only queues
+ * readahead, so the I/O for all files proceeds in parallel. Failures are
+ * logged at information level and never prevent the command from starting.
+ *
+ * @param ctx iexec_option_t context
+ * @param argc number of arguments, including leading NAME=value assignments
+ * @param argv arguments
+ * @param cmdind index of the command in argv
+ */
+void iexec_prewarm(const iexec_option_t *ctx, int argc, char **argv,
+                   int cmdind);
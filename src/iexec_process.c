@@ -1,6 +1,8 @@
 #include "iexec_process.h"
+#include "iexec_journal.h"
 #include "iexec_print.h"
 #include "iexec_privilege.h"
+#include "iexec_trace.h"
 #include <assert.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -28,6 +30,9 @@ void iexec_prctl_set_pdeathsig(int signum) {
 
 pid_t iexec_fork(void) {
   pid_t pid = fork();
+  if (pid != 0) {
+    IEXEC_TRACE2(fork, pid, pid == -1 ? iexec_errno() : 0);
+  }
   if (pid == -1) {
     iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "fork: %s\n",
                  iexec_strerror(iexec_errno()));
@@ -36,6 +41,18 @@ pid_t iexec_fork(void) {
   return pid;
 }
 
+pid_t iexec_try_fork(void) {
+  pid_t pid = fork();
+  if (pid != 0) {
+    IEXEC_TRACE2(fork, pid, pid == -1 ? iexec_errno() : 0);
+  }
+  if (pid == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "fork: %s\n",
+                 iexec_strerror(iexec_errno()));
+  }
+  return pid;
+}
+
 char *iexec_getenv(const char *name) { return getenv(name); }
 
 void iexec_put_envs(int argc, char **argv) {
@@ -46,15 +63,23 @@ void iexec_put_envs(int argc, char **argv) {
 
 void iexec_execvp(const char *file, char *const argv[]) {
   iexec_assert_exec_privilege_contract();
+  IEXEC_TRACE1(exec_start, file);
+  iexec_journal_record_self(IEXEC_JOURNAL_EXEC_START, 0);
   int ret = execvp(file, argv);
   assert(ret == -1);
+  IEXEC_TRACE2(exec_fail, file, iexec_errno());
+  iexec_journal_record_self(IEXEC_JOURNAL_EXEC_FAIL, iexec_errno());
   iexec_printf(IEXEC_PRINT_LEVEL_INFORMATION, "execvp: %s\n",
                iexec_strerror(iexec_errno()));
   iexec_exit(IEXEC_EXIT_NOCMD);
 }
 
 pid_t iexec_getpid(void) { return getpid(); }
-void iexec_exit(int status) { exit(status); }
+void iexec_exit(int status) {
+  IEXEC_TRACE1(exit, status);
+  iexec_journal_record_self(IEXEC_JOURNAL_EXIT, status);
+  exit(status);
+}
 void iexec_exit_from_wait_status(int status) {
   if (WIFEXITED(status)) {
     iexec_exit(WEXITSTATUS(status));
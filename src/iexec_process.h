@@ -6,6 +6,7 @@
 enum {
   IEXEC_EXIT_SUCCESS = 0,
   IEXEC_EXIT_FAILURE = 1,
+  IEXEC_EXIT_TIMEOUT = 124,
   IEXEC_EXIT_NOCMD = 127,
 };
 
@@ -15,6 +16,8 @@ void iexec_prctl_set_pdeathsig(int signum);
 
 pid_t iexec_fork(void);
 
+pid_t iexec_try_fork(void);
+
 char *iexec_getenv(const char *name);
 
 void iexec_put_envs(int argc, char **argv);
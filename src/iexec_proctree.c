@@ -0,0 +1,564 @@
+#include "iexec_proctree.h"
+#include "iexec_cgroup.h"
+#include "iexec_print.h"
+#include "iexec_process.h"
+#include "iexec_wait.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#define IEXEC_PROCTREE_SLOTS 8192
+#define IEXEC_PROCTREE_MAX (IEXEC_PROCTREE_SLOTS / 2)
+#define IEXEC_PROCTREE_SCAN_MAX 8192
+#define IEXEC_PROCTREE_INIT_PIDNS_INO 0xEFFFFFFCu
+
+typedef struct iexec_proctree_entry {
+  pid_t pid;
+  pid_t ppid;
+  pid_t root; /* the child of iexec it descends from, 0 if unknown */
+  unsigned long long start;
+  unsigned int generation;
+} iexec_proctree_entry_t;
+
+typedef struct iexec_proctree_scan {
+  pid_t pid;
+  pid_t ppid;
+  unsigned long long start;
+  int descendant;
+} iexec_proctree_scan_t;
+
+static iexec_proctree_mode_t iexec_proctree_mode = IEXEC_PROCTREE_MODE_OFF;
+static int iexec_proctree_netlink_fd = -1;
+static DIR *iexec_proctree_proc_dir = NULL;
+static iexec_proctree_entry_t iexec_proctree_slots[IEXEC_PROCTREE_SLOTS];
+static iexec_proctree_scan_t iexec_proctree_scanned[IEXEC_PROCTREE_SCAN_MAX];
+static pid_t iexec_proctree_gone[IEXEC_PROCTREE_MAX];
+static pid_t iexec_proctree_self = 0;
+static unsigned int iexec_proctree_generation = 0;
+static unsigned long iexec_proctree_live = 0;
+static unsigned long iexec_proctree_peak = 0;
+static unsigned long iexec_proctree_untracked = 0;
+static unsigned long long iexec_proctree_forks = 0;
+static unsigned long long iexec_proctree_exits = 0;
+static unsigned long iexec_proctree_rate = 0;
+static unsigned long iexec_proctree_bucket = 0;
+static time_t iexec_proctree_bucket_second = 0;
+static int iexec_proctree_interval = 1;
+static unsigned long iexec_proctree_storm_rate = 0;
+static long iexec_proctree_pids_max = -1;
+static int iexec_proctree_storming = 0;
+
+static size_t iexec_proctree_hash(pid_t pid) {
+  return ((size_t)pid * 2654435761u) & (IEXEC_PROCTREE_SLOTS - 1);
+}
+
+static iexec_proctree_entry_t *iexec_proctree_find(pid_t pid) {
+  for (size_t i = iexec_proctree_hash(pid);;
+       i = (i + 1) & (IEXEC_PROCTREE_SLOTS - 1)) {
+    if (iexec_proctree_slots[i].pid == pid) {
+      return &iexec_proctree_slots[i];
+    }
+    if (iexec_proctree_slots[i].pid == 0) {
+      return NULL;
+    }
+  }
+}
+
+static iexec_proctree_entry_t *iexec_proctree_insert(pid_t pid, pid_t ppid) {
+  if (iexec_proctree_live >= IEXEC_PROCTREE_MAX) {
+    iexec_proctree_untracked++;
+    return NULL;
+  }
+  size_t i = iexec_proctree_hash(pid);
+  while (iexec_proctree_slots[i].pid != 0) {
+    i = (i + 1) & (IEXEC_PROCTREE_SLOTS - 1);
+  }
+  // inherited at fork, so orphans keep their subtree after reparenting
+  iexec_proctree_entry_t *parent = iexec_proctree_find(ppid);
+  pid_t root = 0;
+  if (ppid == iexec_proctree_self) {
+    root = pid;
+  } else if (parent != NULL) {
+    root = parent->root;
+  }
+  iexec_proctree_slots[i].pid = pid;
+  iexec_proctree_slots[i].ppid = ppid;
+  iexec_proctree_slots[i].root = root;
+  iexec_proctree_slots[i].start = 0;
+  iexec_proctree_slots[i].generation = iexec_proctree_generation;
+  iexec_proctree_live++;
+  if (iexec_proctree_live > iexec_proctree_peak) {
+    iexec_proctree_peak = iexec_proctree_live;
+  }
+  return &iexec_proctree_slots[i];
+}
+
+static void iexec_proctree_remove(pid_t pid) {
+  iexec_proctree_entry_t *entry = iexec_proctree_find(pid);
+  if (entry == NULL) {
+    return;
+  }
+  // backward-shift deletion keeps linear probing chains intact
+  size_t i = (size_t)(entry - iexec_proctree_slots);
+  size_t j = i;
+  while (1) {
+    j = (j + 1) & (IEXEC_PROCTREE_SLOTS - 1);
+    if (iexec_proctree_slots[j].pid == 0) {
+      break;
+    }
+    size_t k = iexec_proctree_hash(iexec_proctree_slots[j].pid);
+    if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+      iexec_proctree_slots[i] = iexec_proctree_slots[j];
+      i = j;
+    }
+  }
+  iexec_proctree_slots[i].pid = 0;
+  iexec_proctree_live--;
+}
+
+static void iexec_proctree_check_storm(void) {
+  int storming = 0;
+  if (iexec_proctree_storm_rate != 0 &&
+      iexec_proctree_rate >= iexec_proctree_storm_rate) {
+    storming = 1;
+  }
+  if (iexec_proctree_pids_max > 0 &&
+      (long)iexec_proctree_live * 10 >= iexec_proctree_pids_max * 9) {
+    storming = 1;
+  }
+  if (storming && !iexec_proctree_storming) {
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+                 "Warning: fork storm: %lu processes, %lu forks/s, "
+                 "pids.max %ld\n",
+                 iexec_proctree_live, iexec_proctree_rate,
+                 iexec_proctree_pids_max);
+  } else if (!storming && iexec_proctree_storming) {
+    iexec_printf(IEXEC_PRINT_LEVEL_INFORMATION,
+                 "fork storm over: %lu processes, %lu forks/s\n",
+                 iexec_proctree_live, iexec_proctree_rate);
+  }
+  iexec_proctree_storming = storming;
+}
+
+static void iexec_proctree_count_forks(unsigned long forks) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if (now.tv_sec != iexec_proctree_bucket_second) {
+    iexec_proctree_rate = now.tv_sec == iexec_proctree_bucket_second + 1
+                              ? iexec_proctree_bucket
+                              : 0;
+    iexec_proctree_bucket = 0;
+    iexec_proctree_bucket_second = now.tv_sec;
+  }
+  iexec_proctree_bucket += forks;
+  iexec_proctree_forks += forks;
+  if (iexec_proctree_bucket > iexec_proctree_rate) {
+    // react within the current second instead of waiting for it to end
+    iexec_proctree_rate = iexec_proctree_bucket;
+  }
+}
+
+static int iexec_proctree_read_stat(pid_t pid, pid_t *ppid,
+                                    unsigned long long *start) {
+  char path[32];
+  char buf[512];
+  snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return -1;
+  }
+  ssize_t len = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (len <= 0) {
+    return -1;
+  }
+  buf[len] = '\0';
+  // comm may contain spaces and parentheses, so parse after the last ')'
+  char *p = strrchr(buf, ')');
+  int parent;
+  if (p == NULL || sscanf(p + 1,
+                          " %*c %d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u "
+                          "%*u %*d %*d %*d %*d %*d %*d %llu",
+                          &parent, start) != 2) {
+    return -1;
+  }
+  *ppid = parent;
+  return 0;
+}
+
+static int iexec_proctree_compare_scan(const void *lhs, const void *rhs) {
+  pid_t a = ((const iexec_proctree_scan_t *)lhs)->pid;
+  pid_t b = ((const iexec_proctree_scan_t *)rhs)->pid;
+  return (a > b) - (a < b);
+}
+
+static void iexec_proctree_scan_proc(void) {
+  // the directory stream is opened once so scans do not allocate
+  DIR *dir = iexec_proctree_proc_dir;
+  rewinddir(dir);
+  size_t count = 0;
+  struct dirent *ent;
+  while ((ent = readdir(dir)) != NULL && count < IEXEC_PROCTREE_SCAN_MAX) {
+    char *end;
+    long pid = strtol(ent->d_name, &end, 10);
+    if (*end != '\0' || pid <= 0 || pid == iexec_proctree_self) {
+      continue;
+    }
+    iexec_proctree_scan_t *scan = &iexec_proctree_scanned[count];
+    if (iexec_proctree_read_stat((pid_t)pid, &scan->ppid, &scan->start) == -1) {
+      continue;
+    }
+    scan->pid = (pid_t)pid;
+    scan->descendant = scan->ppid == iexec_proctree_self;
+    count++;
+  }
+
+  // propagate descendant marks down the tree until nothing changes
+  qsort(iexec_proctree_scanned, count, sizeof(iexec_proctree_scan_t),
+        iexec_proctree_compare_scan);
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    for (size_t i = 0; i < count; i++) {
+      iexec_proctree_scan_t *scan = &iexec_proctree_scanned[i];
+      if (scan->descendant) {
+        continue;
+      }
+      iexec_proctree_scan_t key;
+      key.pid = scan->ppid;
+      iexec_proctree_scan_t *parent =
+          bsearch(&key, iexec_proctree_scanned, count,
+                  sizeof(iexec_proctree_scan_t), iexec_proctree_compare_scan);
+      if (parent != NULL && parent->descendant) {
+        scan->descendant = 1;
+        changed = 1;
+      }
+    }
+  }
+
+  iexec_proctree_generation++;
+  unsigned long forks = 0;
+  for (size_t i = 0; i < count; i++) {
+    iexec_proctree_scan_t *scan = &iexec_proctree_scanned[i];
+    if (!scan->descendant) {
+      continue;
+    }
+    iexec_proctree_entry_t *entry = iexec_proctree_find(scan->pid);
+    if (entry != NULL && entry->start != scan->start) {
+      // the pid was reused since the last scan
+      iexec_proctree_remove(scan->pid);
+      iexec_proctree_exits++;
+      entry = NULL;
+    }
+    if (entry == NULL) {
+      entry = iexec_proctree_insert(scan->pid, scan->ppid);
+      forks++;
+      if (entry == NULL) {
+        continue;
+      }
+      entry->start = scan->start;
+    }
+    entry->ppid = scan->ppid;
+    entry->generation = iexec_proctree_generation;
+  }
+
+  size_t gone = 0;
+  for (size_t i = 0; i < IEXEC_PROCTREE_SLOTS; i++) {
+    iexec_proctree_entry_t *entry = &iexec_proctree_slots[i];
+    if (entry->pid != 0 && entry->generation != iexec_proctree_generation &&
+        gone < IEXEC_PROCTREE_MAX) {
+      iexec_proctree_gone[gone++] = entry->pid;
+    }
+  }
+  for (size_t i = 0; i < gone; i++) {
+    iexec_proctree_remove(iexec_proctree_gone[i]);
+    iexec_proctree_exits++;
+  }
+
+  // only processes that lived across a scan are seen, so this is a lower bound
+  iexec_proctree_forks += forks;
+  iexec_proctree_rate = forks / (unsigned long)iexec_proctree_interval;
+  iexec_proctree_check_storm();
+}
+
+static void iexec_proctree_on_timer(int fd, void *arg) {
+  uint64_t expirations;
+  (void)arg;
+  if (read(fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "timerfd: %s\n",
+                 iexec_strerror(iexec_errno()));
+  }
+  iexec_proctree_scan_proc();
+}
+
+static void iexec_proctree_on_netlink(int fd, void *arg) {
+  union {
+    char buf[8192];
+    struct nlmsghdr align;
+  } msg;
+  (void)arg;
+  while (1) {
+    ssize_t len = recv(fd, msg.buf, sizeof(msg.buf), 0);
+    if (len == -1) {
+      if (errno == ENOBUFS) {
+        iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+                     "proc connector overrun, process tree may be stale\n");
+        continue;
+      }
+      return;
+    }
+    for (struct nlmsghdr *nl = &msg.align; NLMSG_OK(nl, (size_t)len);
+         nl = NLMSG_NEXT(nl, len)) {
+      if (nl->nlmsg_type != NLMSG_DONE) {
+        continue;
+      }
+      struct cn_msg *cn = NLMSG_DATA(nl);
+      struct proc_event *ev = (struct proc_event *)cn->data;
+      switch (ev->what) {
+      case PROC_EVENT_FORK: {
+        pid_t parent = ev->event_data.fork.parent_tgid;
+        pid_t child = ev->event_data.fork.child_pid;
+        if (child != ev->event_data.fork.child_tgid) {
+          break; // a new thread, not a new process
+        }
+        if (parent == iexec_proctree_self ||
+            iexec_proctree_find(parent) != NULL) {
+          iexec_proctree_insert(child, parent);
+          iexec_proctree_count_forks(1);
+          iexec_proctree_check_storm();
+        }
+        break;
+      }
+      case PROC_EVENT_EXIT:
+        if (ev->event_data.exit.process_pid ==
+                ev->event_data.exit.process_tgid &&
+            iexec_proctree_find(ev->event_data.exit.process_pid) != NULL) {
+          iexec_proctree_remove(ev->event_data.exit.process_pid);
+          iexec_proctree_exits++;
+          iexec_proctree_check_storm();
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+}
+
+static int iexec_proctree_in_init_pidns(void) {
+  struct stat st;
+  return stat("/proc/self/ns/pid", &st) == 0 &&
+         st.st_ino == IEXEC_PROCTREE_INIT_PIDNS_INO;
+}
+
+static int iexec_proctree_open_netlink(void) {
+  union {
+    char buf[NLMSG_SPACE(sizeof(struct cn_msg) +
+                         sizeof(enum proc_cn_mcast_op))];
+    struct nlmsghdr align;
+  } msg;
+  struct sockaddr_nl addr;
+
+  // the connector reports pids from the initial PID namespace only
+  if (!iexec_proctree_in_init_pidns()) {
+    errno = EXDEV;
+    return -1;
+  }
+  int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                  NETLINK_CONNECTOR);
+  if (fd == -1) {
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = CN_IDX_PROC;
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+    close(fd);
+    return -1;
+  }
+  memset(&msg, 0, sizeof(msg));
+  struct nlmsghdr *nl = &msg.align;
+  nl->nlmsg_len = sizeof(msg.buf);
+  nl->nlmsg_type = NLMSG_DONE;
+  struct cn_msg *cn = NLMSG_DATA(nl);
+  cn->id.idx = CN_IDX_PROC;
+  cn->id.val = CN_VAL_PROC;
+  cn->len = sizeof(enum proc_cn_mcast_op);
+  enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+  memcpy(cn->data, &op, sizeof(op));
+  if (send(fd, msg.buf, sizeof(msg.buf), 0) == -1) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void iexec_proctree_start_proc(void) {
+  struct itimerspec spec;
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (fd == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "timerfd_create: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  spec.it_interval.tv_sec = iexec_proctree_interval;
+  spec.it_interval.tv_nsec = 0;
+  spec.it_value = spec.it_interval;
+  if (timerfd_settime(fd, 0, &spec, NULL) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "timerfd_settime: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  iexec_proctree_proc_dir = opendir("/proc");
+  if (iexec_proctree_proc_dir == NULL) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "opendir /proc: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  if (iexec_wait_add_fd(fd, iexec_proctree_on_timer, NULL) == -1) {
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  iexec_proctree_mode = IEXEC_PROCTREE_MODE_PROC;
+}
+
+void iexec_proctree_start(const iexec_option_t *ctx) {
+  char buf[64];
+  if (ctx->proctree == IEXEC_PROCTREE_MODE_OFF) {
+    return;
+  }
+  iexec_proctree_self = iexec_getpid();
+  iexec_proctree_interval = ctx->proctree_interval;
+  iexec_proctree_storm_rate = (unsigned long)ctx->fork_storm_rate;
+  if (iexec_cgroup_read("pids.max", buf, sizeof(buf)) == 0 &&
+      strcmp(buf, "max") != 0) {
+    iexec_proctree_pids_max = strtol(buf, NULL, 10);
+  }
+
+  if (ctx->proctree != IEXEC_PROCTREE_MODE_PROC) {
+    int fd = iexec_proctree_open_netlink();
+    if (fd != -1) {
+      iexec_proctree_netlink_fd = fd;
+      if (iexec_wait_add_fd(fd, iexec_proctree_on_netlink, NULL) == -1) {
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      iexec_proctree_mode = IEXEC_PROCTREE_MODE_NETLINK;
+      return;
+    }
+    iexec_printf(ctx->proctree == IEXEC_PROCTREE_MODE_NETLINK
+                     ? IEXEC_PRINT_LEVEL_WARNING
+                     : IEXEC_PRINT_LEVEL_INFORMATION,
+                 "proc connector unavailable (%s), scanning /proc\n",
+                 iexec_strerror(iexec_errno()));
+  }
+  iexec_proctree_start_proc();
+}
+
+/* bring the table up to date before it is acted on */
+static void iexec_proctree_refresh(void) {
+  if (iexec_proctree_mode == IEXEC_PROCTREE_MODE_PROC) {
+    iexec_proctree_scan_proc();
+  } else if (iexec_proctree_mode == IEXEC_PROCTREE_MODE_NETLINK) {
+    // children are reaped before their queued exit events are read
+    iexec_proctree_on_netlink(iexec_proctree_netlink_fd, NULL);
+  }
+}
+
+void iexec_proctree_reaped(pid_t pid) {
+  if (iexec_proctree_mode == IEXEC_PROCTREE_MODE_OFF ||
+      iexec_proctree_find(pid) == NULL) {
+    return;
+  }
+  iexec_proctree_remove(pid);
+  iexec_proctree_exits++;
+}
+
+void iexec_proctree_report_stragglers(void) {
+  if (iexec_proctree_mode == IEXEC_PROCTREE_MODE_OFF) {
+    return;
+  }
+  iexec_proctree_refresh();
+  if (iexec_proctree_live == 0) {
+    return;
+  }
+  iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+               "Warning: %lu descendants still running after main child "
+               "exit\n",
+               iexec_proctree_live);
+  for (size_t i = 0; i < IEXEC_PROCTREE_SLOTS; i++) {
+    iexec_proctree_entry_t *entry = &iexec_proctree_slots[i];
+    char path[32];
+    char comm[17] = "?";
+    if (entry->pid == 0) {
+      continue;
+    }
+    snprintf(path, sizeof(path), "/proc/%d/comm", (int)entry->pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+      ssize_t len = read(fd, comm, sizeof(comm) - 1);
+      if (len > 0) {
+        comm[len] = '\0';
+        comm[strcspn(comm, "\n")] = '\0';
+      }
+      close(fd);
+    }
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+                 "Warning: straggler pid %d (%s), parent %d\n", (int)entry->pid,
+                 comm, (int)entry->ppid);
+  }
+}
+
+size_t iexec_proctree_kill(pid_t root, int signum) {
+  if (iexec_proctree_mode == IEXEC_PROCTREE_MODE_OFF) {
+    return 0;
+  }
+  iexec_proctree_refresh();
+  size_t count = 0;
+  for (size_t i = 0; i < IEXEC_PROCTREE_SLOTS; i++) {
+    iexec_proctree_entry_t *entry = &iexec_proctree_slots[i];
+    if (entry->pid == 0 || entry->pid == root || entry->root != root) {
+      continue;
+    }
+    if (kill(entry->pid, signum) == 0) {
+      count++;
+    }
+  }
+  return count;
+}
+
+size_t iexec_proctree_format_stats(char *buf, size_t size) {
+  static const char *const modes[] = {"off", "auto", "netlink", "proc"};
+  if (iexec_proctree_mode == IEXEC_PROCTREE_MODE_NETLINK) {
+    // roll the per-second bucket forward even if nothing forked lately
+    iexec_proctree_count_forks(0);
+  }
+  int len = snprintf(buf, size,
+                     "tree_mode %s\n"
+                     "tree_live %lu\n"
+                     "tree_peak %lu\n"
+                     "tree_untracked %lu\n"
+                     "tree_forks_total %llu\n"
+                     "tree_exits_total %llu\n"
+                     "tree_fork_rate %lu\n"
+                     "tree_pids_max %ld\n",
+                     modes[iexec_proctree_mode], iexec_proctree_live,
+                     iexec_proctree_peak, iexec_proctree_untracked,
+                     iexec_proctree_forks, iexec_proctree_exits,
+                     iexec_proctree_rate, iexec_proctree_pids_max);
+  if (len < 0) {
+    return 0;
+  }
+  return (size_t)len < size ? (size_t)len : size - 1;
+}
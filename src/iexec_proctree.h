@@ -0,0 +1,56 @@
+#pragma once
+
+#include "iexec.h"
+#include "iexec_option.h"
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * @brief Start tracking the descendant process tree from the wait loop
+ *
+ * The netlink proc connector is used when requested and permitted; otherwise
+ * /proc is scanned periodically.
+ *
+ * @param ctx iexec_option_t context
+ */
+void iexec_proctree_start(const iexec_option_t *ctx);
+
+/**
+ * @brief Forget a child reaped by the wait loop
+ *
+ * Its exit event may still be queued on the proc connector.
+ *
+ * @param pid reaped pid
+ */
+void iexec_proctree_reaped(pid_t pid);
+
+/**
+ * @brief Log descendants that are still alive after the main child exited
+ *
+ * Queued proc connector events are read first, or /proc is rescanned.
+ */
+void iexec_proctree_report_stragglers(void);
+
+/**
+ * @brief Signal the tracked descendants of a child of iexec
+ *
+ * Descendants are attributed to the child of iexec they were forked under,
+ * so orphans that were reparented to iexec are still found. With the /proc
+ * scan, the tree is rescanned first, and a process first seen after its
+ * parent exited counts as a child of iexec. Queued proc connector events
+ * are read first.
+ *
+ * @param root child of iexec, which is not signaled itself
+ * @param signum signal number
+ * @return number of processes signaled, 0 when tracking is off
+ */
+size_t iexec_proctree_kill(pid_t root, int signum);
+
+/**
+ * @brief Format process tree metrics as "name value" lines
+ *
+ * @param buf output buffer
+ * @param size output buffer size
+ * @return number of bytes written (excluding the terminating NUL)
+ */
+size_t iexec_proctree_format_stats(char *buf, size_t size);
@@ -0,0 +1,223 @@
+#include "iexec_reload.h"
+#include "iexec_command.h"
+#include "iexec_forward.h"
+#include "iexec_journal.h"
+#include "iexec_print.h"
+#include "iexec_process.h"
+#include "iexec_syscall.h"
+#include "iexec_wait.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+static int iexec_reload_signal = 0;
+static int iexec_reload_stop_signal = SIGTERM;
+static int iexec_reload_timeout = 10;
+static volatile sig_atomic_t iexec_reload_requested = 0;
+static int iexec_reload_timer = -1;
+static int iexec_reload_ready_fd = -1;
+static pid_t iexec_reload_candidate = -1;
+static int iexec_reload_ready = 0;
+static int iexec_reload_candidate_reaped = 0;
+
+static void iexec_reload_request(int signum) {
+  iexec_journal_record(IEXEC_JOURNAL_SIGNAL, 0, signum, 0);
+  iexec_reload_requested = 1;
+}
+
+void iexec_reload_configure(const iexec_option_t *ctx) {
+  iexec_reload_signal = ctx->reload_signal;
+  iexec_reload_stop_signal = ctx->reload_stop_signal;
+  iexec_reload_timeout = ctx->reload_timeout;
+}
+
+int iexec_reload_signal_number(void) { return iexec_reload_signal; }
+
+static void iexec_reload_on_timer(int fd, void *arg);
+
+void iexec_reload_install(void) {
+  if (iexec_reload_signal == 0) {
+    return;
+  }
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = iexec_reload_request;
+  sigemptyset(&action.sa_mask);
+  iexec_command_catch_signal(iexec_reload_signal);
+  if (iexec_sigaction(iexec_reload_signal, &action, NULL) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "sigaction: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  iexec_reload_timer =
+      iexec_timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (iexec_reload_timer == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "timerfd_create: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  if (iexec_wait_add_fd(iexec_reload_timer, iexec_reload_on_timer, NULL) ==
+      -1) {
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+}
+
+int iexec_reload_take(void) {
+  int requested = iexec_reload_requested;
+  iexec_reload_requested = 0;
+  return requested;
+}
+
+static void iexec_reload_prepare_child(void *arg) {
+  int fd = *(int *)arg;
+  char value[16];
+  if (fcntl(fd, F_SETFD, 0) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "fcntl: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  snprintf(value, sizeof(value), "%d", fd);
+  setenv("IEXEC_READY_FD", value, 1);
+}
+
+static void iexec_reload_finish(void) {
+  iexec_wait_remove_fd(iexec_reload_ready_fd);
+  iexec_close(iexec_reload_ready_fd);
+  iexec_reload_ready_fd = -1;
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  iexec_timerfd_settime(iexec_reload_timer, 0, &spec, NULL);
+}
+
+/* a live candidate is killed and reaped by the wait loop as a descendant */
+static void iexec_reload_reject(void) {
+  pid_t pid = iexec_reload_candidate;
+  if (iexec_reload_ready_fd != -1) {
+    iexec_reload_finish();
+  }
+  iexec_reload_candidate = -1;
+  iexec_reload_ready = 0;
+  // a reaped pid may have been reused
+  if (!iexec_reload_candidate_reaped) {
+    iexec_forward_kill(pid, SIGKILL);
+  }
+  iexec_journal_record(IEXEC_JOURNAL_RELOAD_FAIL, pid, 0, 0);
+}
+
+static void iexec_reload_roll_back(void) {
+  iexec_reload_reject();
+  iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+               "Reload: rolled back, keeping current instance\n");
+}
+
+static void iexec_reload_on_ready(int fd, void *arg) {
+  char c;
+  (void)arg;
+  ssize_t ret = iexec_read(fd, &c, 1);
+  if (ret == -1 && (errno == EINTR || errno == EAGAIN)) {
+    return;
+  }
+  if (ret != 1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+                 "Reload: pid %d exited before becoming ready\n",
+                 iexec_reload_candidate);
+    iexec_reload_roll_back();
+    return;
+  }
+  iexec_reload_finish();
+  iexec_reload_ready = 1;
+}
+
+static void iexec_reload_on_timer(int fd, void *arg) {
+  uint64_t expirations;
+  (void)arg;
+  if (iexec_read(fd, &expirations, sizeof(expirations)) == -1 ||
+      iexec_reload_candidate == -1 || iexec_reload_ready) {
+    return;
+  }
+  iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+               "Reload: pid %d not ready within %d seconds\n",
+               iexec_reload_candidate, iexec_reload_timeout);
+  iexec_reload_roll_back();
+}
+
+int iexec_reload_pending(void) { return iexec_reload_candidate != -1; }
+
+void iexec_reload_spawn(void) {
+  int fds[2];
+
+  if (iexec_pipe2(fds, O_CLOEXEC) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "pipe2: %s\n",
+                 iexec_strerror(iexec_errno()));
+    return;
+  }
+  pid_t pid = iexec_command_spawn(iexec_reload_prepare_child, &fds[1]);
+  iexec_close(fds[1]);
+  if (pid == -1) {
+    iexec_close(fds[0]);
+    return;
+  }
+  iexec_printf(IEXEC_PRINT_LEVEL_INFORMATION,
+               "Reload: started pid %d, waiting for readiness\n", pid);
+  iexec_reload_candidate = pid;
+  iexec_reload_ready = 0;
+  iexec_reload_candidate_reaped = 0;
+  iexec_reload_ready_fd = fds[0];
+  if (iexec_wait_add_fd(iexec_reload_ready_fd, iexec_reload_on_ready, NULL) ==
+      -1) {
+    iexec_reload_roll_back();
+    return;
+  }
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = iexec_reload_timeout;
+  // a zero value would disarm the timer rather than expire at once
+  spec.it_value.tv_nsec = iexec_reload_timeout == 0 ? 1 : 0;
+  if (iexec_timerfd_settime(iexec_reload_timer, 0, &spec, NULL) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "timerfd_settime: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+}
+
+pid_t iexec_reload_take_ready(void) {
+  if (!iexec_reload_ready) {
+    return -1;
+  }
+  pid_t pid = iexec_reload_candidate;
+  iexec_reload_ready = 0;
+  iexec_reload_candidate = -1;
+  return pid;
+}
+
+void iexec_reload_reaped(pid_t pid) {
+  if (pid != iexec_reload_candidate) {
+    return;
+  }
+  iexec_reload_candidate_reaped = 1;
+  iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+               "Reload: pid %d exited before taking over\n", pid);
+  iexec_reload_roll_back();
+}
+
+void iexec_reload_cancel(void) {
+  if (iexec_reload_candidate == -1) {
+    return;
+  }
+  iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+               "Reload: main child exited, stopping pid %d\n",
+               iexec_reload_candidate);
+  iexec_reload_reject();
+}
+
+void iexec_reload_stop(pid_t pid) {
+  iexec_printf(IEXEC_PRINT_LEVEL_INFORMATION,
+               "Reload: stopping replaced pid %d\n", pid);
+  iexec_forward_kill(pid, iexec_reload_stop_signal);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "iexec.h"
+#include "iexec_option.h"
+#include <sys/types.h>
+
+/**
+ * @brief Take reload settings from the parsed options
+ *
+ * @param ctx iexec_option_t context
+ */
+void iexec_reload_configure(const iexec_option_t *ctx);
+
+/**
+ * @brief Get the signal that requests a reload
+ *
+ * @return signal number, or 0 when reload is disabled
+ */
+int iexec_reload_signal_number(void);
+
+/**
+ * @brief Install the reload signal handler (no-op when reload is disabled)
+ *
+ * The wait loop keeps the reload signal blocked outside ppoll. The readiness
+ * timer is registered with the wait loop.
+ */
+void iexec_reload_install(void);
+
+/**
+ * @brief Consume a pending reload request
+ *
+ * @return non-zero when a reload signal was received since the last call
+ */
+int iexec_reload_take(void);
+
+/**
+ * @brief Check whether a reload candidate is waiting for readiness
+ *
+ * @return non-zero from iexec_reload_spawn until the candidate is taken or
+ *         rejected
+ */
+int iexec_reload_pending(void);
+
+/**
+ * @brief Start a new instance of the command as a reload candidate
+ *
+ * Returns at once; the wait loop serves the readiness fd and timer. A
+ * candidate that exits, closes its readiness fd, or misses the timeout is
+ * killed and reaped by the wait loop as an ordinary descendant, and the
+ * current instance is kept.
+ */
+void iexec_reload_spawn(void);
+
+/**
+ * @brief Take the candidate once it has become ready
+ *
+ * @return pid of the ready candidate, or -1 when there is none
+ */
+pid_t iexec_reload_take_ready(void);
+
+/**
+ * @brief Handle a reaped child
+ *
+ * A candidate that exits before it is taken, even after becoming ready, is
+ * rolled back without being signalled, and the current instance is kept.
+ *
+ * @param pid reaped pid
+ */
+void iexec_reload_reaped(pid_t pid);
+
+/**
+ * @brief Kill a pending candidate because the main child exited
+ */
+void iexec_reload_cancel(void);
+
+/**
+ * @brief Send the configured shutdown signal to the replaced instance
+ *
+ * @param pid pid of the replaced instance
+ */
+void iexec_reload_stop(pid_t pid);
@@ -0,0 +1,49 @@
+#include "iexec_syscall.h"
+#include <fcntl.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+pid_t iexec_wait4(pid_t pid, int *status, int options, struct rusage *usage) {
+  return wait4(pid, status, options, usage);
+}
+
+int iexec_waitid(idtype_t idtype, id_t id, siginfo_t *info, int options) {
+  return waitid(idtype, id, info, options);
+}
+
+int iexec_ppoll(struct pollfd *fds, nfds_t nfds, const struct timespec *timeout,
+                const sigset_t *sigmask) {
+  return ppoll(fds, nfds, timeout, sigmask);
+}
+
+int iexec_sigaction(int signum, const struct sigaction *action,
+                    struct sigaction *old) {
+  return sigaction(signum, action, old);
+}
+
+int iexec_sigprocmask(int how, const sigset_t *set, sigset_t *old) {
+  return sigprocmask(how, set, old);
+}
+
+int iexec_kill(pid_t pid, int signum) { return kill(pid, signum); }
+
+int iexec_sigqueue(pid_t pid, int signum, union sigval value) {
+  return sigqueue(pid, signum, value);
+}
+
+int iexec_pipe2(int fds[2], int flags) { return pipe2(fds, flags); }
+
+ssize_t iexec_read(int fd, void *buf, size_t count) {
+  return read(fd, buf, count);
+}
+
+int iexec_close(int fd) { return close(fd); }
+
+int iexec_timerfd_create(int clockid, int flags) {
+  return timerfd_create(clockid, flags);
+}
+
+int iexec_timerfd_settime(int fd, int flags, const struct itimerspec *value,
+                          struct itimerspec *old) {
+  return timerfd_settime(fd, flags, value, old);
+}
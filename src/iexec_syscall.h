@@ -0,0 +1,81 @@
+#pragma once
+
+#include "iexec.h"
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+
+/*
+ * System call seams of the wait loop and the reload handover.
+ *
+ * Each wrapper has exactly the contract of the system call it is named after.
+ * They live in their own translation unit so that the simulator
+ * (tests/iexec_sim.c) can link iexec_wait.c and iexec_reload.c against a fake
+ * kernel instead.
+ */
+
+/**
+ * @brief wait4(2)
+ */
+pid_t iexec_wait4(pid_t pid, int *status, int options, struct rusage *usage);
+
+/**
+ * @brief waitid(2)
+ */
+int iexec_waitid(idtype_t idtype, id_t id, siginfo_t *info, int options);
+
+/**
+ * @brief ppoll(2)
+ */
+int iexec_ppoll(struct pollfd *fds, nfds_t nfds, const struct timespec *timeout,
+                const sigset_t *sigmask);
+
+/**
+ * @brief sigaction(2)
+ */
+int iexec_sigaction(int signum, const struct sigaction *action,
+                    struct sigaction *old);
+
+/**
+ * @brief sigprocmask(2)
+ */
+int iexec_sigprocmask(int how, const sigset_t *set, sigset_t *old);
+
+/**
+ * @brief kill(2)
+ */
+int iexec_kill(pid_t pid, int signum);
+
+/**
+ * @brief sigqueue(3)
+ */
+int iexec_sigqueue(pid_t pid, int signum, union sigval value);
+
+/**
+ * @brief pipe2(2)
+ */
+int iexec_pipe2(int fds[2], int flags);
+
+/**
+ * @brief read(2)
+ */
+ssize_t iexec_read(int fd, void *buf, size_t count);
+
+/**
+ * @brief close(2)
+ */
+int iexec_close(int fd);
+
+/**
+ * @brief timerfd_create(2)
+ */
+int iexec_timerfd_create(int clockid, int flags);
+
+/**
+ * @brief timerfd_settime(2)
+ */
+int iexec_timerfd_settime(int fd, int flags, const struct itimerspec *value,
+                          struct itimerspec *old);
@@ -0,0 +1,246 @@
+#include "iexec_timeout.h"
+#include "iexec_forward.h"
+#include "iexec_journal.h"
+#include "iexec_print.h"
+#include "iexec_process.h"
+#include "iexec_proctree.h"
+#include "iexec_wait.h"
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* the main child, plus replaced instances that are still stopping */
+#define IEXEC_TIMEOUT_INSTANCES 4
+
+typedef enum iexec_timeout_state {
+  IEXEC_TIMEOUT_RUNNING,
+  IEXEC_TIMEOUT_SIGNALED,
+  IEXEC_TIMEOUT_KILLED
+} iexec_timeout_state_t;
+
+typedef struct iexec_timeout_entry {
+  pid_t pid;
+  iexec_timeout_state_t state;
+  long long deadline; /* CLOCK_MONOTONIC milliseconds, 0 for none */
+} iexec_timeout_entry_t;
+
+static long long iexec_timeout_ms = 0;
+static long long iexec_timeout_kill_after_ms = 0;
+static int iexec_timeout_signal = SIGTERM;
+static int iexec_timeout_tree = 0;
+static rlim_t iexec_timeout_cpu_seconds = 0;
+static int iexec_timeout_timer = -1;
+static long long iexec_timeout_armed = 0;
+static iexec_timeout_entry_t *iexec_timeout_entries = NULL;
+static size_t iexec_timeout_count = 0;
+static size_t iexec_timeout_capacity = 0;
+static unsigned long long iexec_timeout_expired = 0;
+static unsigned long long iexec_timeout_kills = 0;
+static unsigned long long iexec_timeout_cpu_exceeded = 0;
+
+static long long iexec_timeout_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void iexec_timeout_arm(long long deadline) {
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = (time_t)(deadline / 1000);
+  spec.it_value.tv_nsec = (long)(deadline % 1000) * 1000000;
+  if (timerfd_settime(iexec_timeout_timer, TFD_TIMER_ABSTIME, &spec, NULL) ==
+      -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "timerfd_settime: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  iexec_timeout_armed = deadline;
+}
+
+static void iexec_timeout_send(const iexec_timeout_entry_t *entry,
+                               int signum) {
+  const char *name = sigabbrev_np(signum);
+  iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+               "Timeout: pid %d still running, sending SIG%s\n",
+               (int)entry->pid, name != NULL ? name : "RT");
+  iexec_forward_kill(entry->pid, signum);
+  size_t tree = 0;
+  if (iexec_timeout_tree) {
+    tree = iexec_proctree_kill(entry->pid, signum);
+  }
+  iexec_journal_record(IEXEC_JOURNAL_TIMEOUT, entry->pid, signum,
+                       (int32_t)tree);
+}
+
+static void iexec_timeout_on_timer(int fd, void *arg) {
+  uint64_t expirations;
+  (void)arg;
+  if (read(fd, &expirations, sizeof(expirations)) == -1) {
+    return;
+  }
+  long long now = iexec_timeout_now();
+  long long next = 0;
+  for (size_t i = 0; i < iexec_timeout_count; i++) {
+    iexec_timeout_entry_t *entry = &iexec_timeout_entries[i];
+    if (entry->deadline != 0 && entry->deadline <= now) {
+      if (entry->state == IEXEC_TIMEOUT_RUNNING) {
+        iexec_timeout_expired++;
+        iexec_timeout_send(entry, iexec_timeout_signal);
+        entry->state = IEXEC_TIMEOUT_SIGNALED;
+        entry->deadline = iexec_timeout_kill_after_ms == 0
+                              ? 0
+                              : now + iexec_timeout_kill_after_ms;
+      } else {
+        iexec_timeout_kills++;
+        iexec_timeout_send(entry, SIGKILL);
+        entry->state = IEXEC_TIMEOUT_KILLED;
+        entry->deadline = 0;
+      }
+    }
+    if (entry->deadline != 0 && (next == 0 || entry->deadline < next)) {
+      next = entry->deadline;
+    }
+  }
+  // a zero deadline disarms the timer
+  iexec_timeout_arm(next);
+}
+
+void iexec_timeout_configure(const iexec_option_t *ctx) {
+  iexec_timeout_ms = ctx->timeout_ms;
+  iexec_timeout_kill_after_ms = ctx->kill_after_ms;
+  iexec_timeout_signal = ctx->timeout_signal;
+  iexec_timeout_tree = ctx->timeout_tree;
+  // RLIMIT_CPU counts whole seconds
+  iexec_timeout_cpu_seconds = (rlim_t)((ctx->cpu_limit_ms + 999) / 1000);
+  if (iexec_timeout_ms == 0 && iexec_timeout_cpu_seconds == 0) {
+    return;
+  }
+  // sized once, so that the wait loop does not allocate
+  iexec_timeout_capacity = ctx->jobs_path != NULL
+                               ? (size_t)ctx->jobs_parallel
+                               : IEXEC_TIMEOUT_INSTANCES;
+  iexec_timeout_entries =
+      calloc(iexec_timeout_capacity, sizeof(*iexec_timeout_entries));
+  if (iexec_timeout_entries == NULL) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "calloc: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  if (iexec_timeout_ms == 0) {
+    return;
+  }
+  iexec_timeout_timer =
+      timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (iexec_timeout_timer == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "timerfd_create: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  if (iexec_wait_add_fd(iexec_timeout_timer, iexec_timeout_on_timer, NULL) ==
+      -1) {
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+}
+
+void iexec_timeout_child(void) {
+  if (iexec_timeout_cpu_seconds == 0) {
+    return;
+  }
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_CPU, &limit) == -1) {
+    limit.rlim_max = RLIM_INFINITY;
+  }
+  rlim_t grace = (rlim_t)((iexec_timeout_kill_after_ms + 999) / 1000);
+  rlim_t soft = iexec_timeout_cpu_seconds;
+  rlim_t hard = soft + (grace == 0 ? 1 : grace);
+  // an unprivileged child cannot raise its hard limit
+  if (limit.rlim_max != RLIM_INFINITY && hard > limit.rlim_max) {
+    hard = limit.rlim_max;
+    soft = soft < hard ? soft : hard;
+  }
+  limit.rlim_cur = soft;
+  limit.rlim_max = hard;
+  if (setrlimit(RLIMIT_CPU, &limit) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "Warning: setrlimit: %s\n",
+                 iexec_strerror(iexec_errno()));
+  }
+}
+
+void iexec_timeout_watch(pid_t pid) {
+  if (iexec_timeout_ms == 0 && iexec_timeout_cpu_seconds == 0) {
+    return;
+  }
+  // only reloads faster than replaced instances stop can fill the table
+  if (iexec_timeout_count == iexec_timeout_capacity) {
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+                 "Warning: Timeout: too many instances running, pid %d is "
+                 "not limited\n",
+                 (int)pid);
+    return;
+  }
+  iexec_timeout_entry_t *entry = &iexec_timeout_entries[iexec_timeout_count++];
+  entry->pid = pid;
+  entry->state = IEXEC_TIMEOUT_RUNNING;
+  entry->deadline = 0;
+  if (iexec_timeout_ms == 0) {
+    return;
+  }
+  entry->deadline = iexec_timeout_now() + iexec_timeout_ms;
+  // with one timeout for all, later children never have earlier deadlines,
+  // so the timer is set once per batch rather than once per child
+  if (iexec_timeout_armed == 0 || entry->deadline < iexec_timeout_armed) {
+    iexec_timeout_arm(entry->deadline);
+  }
+}
+
+iexec_timeout_limit_t iexec_timeout_reaped(pid_t pid, int status,
+                                           const struct rusage *usage) {
+  size_t i = 0;
+  while (i < iexec_timeout_count && iexec_timeout_entries[i].pid != pid) {
+    i++;
+  }
+  if (i == iexec_timeout_count) {
+    return IEXEC_TIMEOUT_LIMIT_NONE;
+  }
+  // the timer may fire for a deadline that is gone, which is harmless
+  iexec_timeout_state_t state = iexec_timeout_entries[i].state;
+  iexec_timeout_entries[i] = iexec_timeout_entries[--iexec_timeout_count];
+  if (state != IEXEC_TIMEOUT_RUNNING) {
+    return IEXEC_TIMEOUT_LIMIT_WALL;
+  }
+  if (iexec_timeout_cpu_seconds == 0 || !WIFSIGNALED(status)) {
+    return IEXEC_TIMEOUT_LIMIT_NONE;
+  }
+  long long used_ms = ((long long)usage->ru_utime.tv_sec +
+                       (long long)usage->ru_stime.tv_sec) *
+                          1000 +
+                      (usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) /
+                          1000;
+  if (WTERMSIG(status) == SIGXCPU ||
+      (WTERMSIG(status) == SIGKILL &&
+       used_ms >= (long long)iexec_timeout_cpu_seconds * 1000)) {
+    iexec_timeout_cpu_exceeded++;
+    return IEXEC_TIMEOUT_LIMIT_CPU;
+  }
+  return IEXEC_TIMEOUT_LIMIT_NONE;
+}
+
+size_t iexec_timeout_format_stats(char *buf, size_t size) {
+  int len = snprintf(buf, size,
+                     "timeout_expired_total %llu\n"
+                     "timeout_kills_total %llu\n"
+                     "timeout_cpu_exceeded_total %llu\n",
+                     iexec_timeout_expired, iexec_timeout_kills,
+                     iexec_timeout_cpu_exceeded);
+  if (len < 0) {
+    return 0;
+  }
+  return (size_t)len < size ? (size_t)len : size - 1;
+}
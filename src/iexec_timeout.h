@@ -0,0 +1,62 @@
+#pragma once
+
+#include "iexec.h"
+#include "iexec_option.h"
+#include <stddef.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+typedef enum iexec_timeout_limit {
+  IEXEC_TIMEOUT_LIMIT_NONE,
+  IEXEC_TIMEOUT_LIMIT_WALL, /* --timeout expired */
+  IEXEC_TIMEOUT_LIMIT_CPU   /* --cpu-limit exceeded */
+} iexec_timeout_limit_t;
+
+/**
+ * @brief Record the limits and create the deadline timer for --timeout
+ *
+ * The timer is served by the wait loop; --cpu-limit alone needs none.
+ *
+ * @param ctx iexec_option_t context
+ */
+void iexec_timeout_configure(const iexec_option_t *ctx);
+
+/**
+ * @brief Apply the CPU time budget to a child
+ *
+ * Called in the child before exec. The soft RLIMIT_CPU is the budget, so the
+ * kernel sends SIGXCPU, and the hard one adds the --kill-after grace (at
+ * least a second) before SIGKILL.
+ */
+void iexec_timeout_child(void);
+
+/**
+ * @brief Start the deadline of a new child
+ *
+ * @param pid main child or job pid
+ */
+void iexec_timeout_watch(pid_t pid);
+
+/**
+ * @brief Forget a reaped child and tell whether it hit a limit
+ *
+ * A child signaled on timeout counts as timed out however it exits. A child
+ * counts as over its CPU budget when SIGXCPU, or SIGKILL after using up the
+ * budget, ended it.
+ *
+ * @param pid reaped child
+ * @param status wait status
+ * @param usage resource usage of the child
+ * @return the limit the child hit, if any
+ */
+iexec_timeout_limit_t iexec_timeout_reaped(pid_t pid, int status,
+                                           const struct rusage *usage);
+
+/**
+ * @brief Format timeout metrics as "name value" lines
+ *
+ * @param buf output buffer
+ * @param size output buffer size
+ * @return number of bytes written (excluding the terminating NUL)
+ */
+size_t iexec_timeout_format_stats(char *buf, size_t size);
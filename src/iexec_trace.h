@@ -0,0 +1,42 @@
+#pragma once
+
+#include "iexec.h"
+
+/*
+ * USDT static tracepoints (provider "iexec").
+ *
+ * Probes are compiled in only with ./configure --enable-usdt; otherwise the
+ * macros expand to nothing and their arguments are not evaluated.
+ *
+ *   fork(pid, errno)              after fork in the parent, pid -1 on failure
+ *   exec_start(file)              in the child, right before execvp
+ *   exec_fail(file, errno)        in the child, after execvp failed
+ *   reap(pid, status, is_main)    after wait reported a child
+ *   forward(signum, signum_out, pid, result)
+ *                                 after a signal was forwarded with kill;
+ *                                 signum_out differs with --signal-rewrite
+ *   reload(old_pid, new_pid)      after a reload handover completed
+ *   exit(status)                  right before iexec exits
+ */
+
+#ifdef IEXEC_ENABLE_USDT
+#include <sys/sdt.h>
+#define IEXEC_TRACE1(name, a1) DTRACE_PROBE1(iexec, name, a1)
+#define IEXEC_TRACE2(name, a1, a2) DTRACE_PROBE2(iexec, name, a1, a2)
+#define IEXEC_TRACE3(name, a1, a2, a3) DTRACE_PROBE3(iexec, name, a1, a2, a3)
+#define IEXEC_TRACE4(name, a1, a2, a3, a4)                                     \
+  DTRACE_PROBE4(iexec, name, a1, a2, a3, a4)
+#else
+#define IEXEC_TRACE1(name, a1)                                                 \
+  do {                                                                         \
+  } while (0)
+#define IEXEC_TRACE2(name, a1, a2)                                             \
+  do {                                                                         \
+  } while (0)
+#define IEXEC_TRACE3(name, a1, a2, a3)                                         \
+  do {                                                                         \
+  } while (0)
+#define IEXEC_TRACE4(name, a1, a2, a3, a4)                                     \
+  do {                                                                         \
+  } while (0)
+#endif
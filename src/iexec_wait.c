@@ -1,62 +1,165 @@
 #include "iexec_wait.h"
+#include "iexec_command.h"
+#include "iexec_control.h"
+#include "iexec_forward.h"
+#include "iexec_jobs.h"
+#include "iexec_journal.h"
 #include "iexec_print.h"
 #include "iexec_process.h"
+#include "iexec_proctree.h"
+#include "iexec_reload.h"
+#include "iexec_syscall.h"
+#include "iexec_timeout.h"
+#include "iexec_trace.h"
+#include "iexec_watchdog.h"
 #include <errno.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/wait.h>
 
-static volatile sig_atomic_t iexec_signal_forward_pid = -1;
+#define IEXEC_WAIT_MAX_FDS 32
 
-static void iexec_forward_signal_to_child(int signum) {
-  pid_t pid_child = (pid_t)iexec_signal_forward_pid;
-  if (pid_child > 0) {
-    kill(pid_child, signum);
+typedef struct iexec_wait_fd {
+  int fd;
+  iexec_wait_fd_handler_t handler;
+  void *arg;
+} iexec_wait_fd_t;
+
+static iexec_wait_fd_t iexec_wait_fds[IEXEC_WAIT_MAX_FDS];
+static int iexec_wait_fd_count = 0;
+
+static pid_t iexec_wait_reap(int *status, int options, struct rusage *usage) {
+  if (!iexec_journal_enabled()) {
+    return iexec_wait4(-1, status, options, usage);
+  }
+  // peek first so the journal can name the child before it disappears
+  siginfo_t info;
+  memset(&info, 0, sizeof(info));
+  if (iexec_waitid(P_ALL, 0, &info, WEXITED | WNOWAIT | options) == -1) {
+    return -1;
   }
+  if (info.si_pid == 0) {
+    return 0;
+  }
+  iexec_journal_stage_comm(info.si_pid);
+  return iexec_wait4(info.si_pid, status, options, usage);
 }
 
-static void iexec_install_signal_forwarder(int signum) {
+static void iexec_wait_reaped(pid_t pid, int status, int is_main) {
+  IEXEC_TRACE3(reap, pid, status, is_main);
+  iexec_journal_record(IEXEC_JOURNAL_REAP, pid, status, is_main);
+  iexec_control_reaped(pid, status);
+  iexec_proctree_reaped(pid);
+  iexec_reload_reaped(pid);
+}
+
+static void iexec_wait_wakeup(int signum) { (void)signum; }
+
+static void iexec_wait_prepare_signals(sigset_t *mask_poll, int forwarding) {
   struct sigaction action;
+  sigset_t mask;
+  int signum = iexec_reload_signal_number();
+
+  // SIGCHLD needs a handler, or ppoll is not interrupted by child exits
   memset(&action, 0, sizeof(action));
-  action.sa_handler = iexec_forward_signal_to_child;
+  action.sa_handler = iexec_wait_wakeup;
+  action.sa_flags = SA_NOCLDSTOP;
   sigemptyset(&action.sa_mask);
-  if (sigaction(signum, &action, NULL) == -1) {
+  iexec_command_catch_signal(SIGCHLD);
+  if (iexec_sigaction(SIGCHLD, &action, NULL) == -1) {
     iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "sigaction: %s\n",
                  iexec_strerror(iexec_errno()));
     iexec_exit(IEXEC_EXIT_FAILURE);
   }
-}
-
-static void iexec_install_signal_forwarders(pid_t pid_child) {
-  iexec_signal_forward_pid = pid_child;
-  iexec_install_signal_forwarder(SIGTERM);
-  iexec_install_signal_forwarder(SIGINT);
-  iexec_install_signal_forwarder(SIGHUP);
-  iexec_install_signal_forwarder(SIGQUIT);
-}
 
-static void iexec_wait_for_sigchld_or_timeout(void) {
-  sigset_t mask;
+  // keep wakeup signals blocked except while sleeping in ppoll; forwarded
+  // signals too, so the forward pid never changes under a running forwarder
   sigemptyset(&mask);
   sigaddset(&mask, SIGCHLD);
-  struct timespec timeout = {1, 0};
-  int sig = sigtimedwait(&mask, NULL, &timeout);
-  if (sig == -1) {
-    if (errno == EAGAIN) {
+  if (signum != 0) {
+    sigaddset(&mask, signum);
+  }
+  if (forwarding) {
+    sigorset(&mask, &mask, iexec_forward_signals());
+  }
+  if (iexec_sigprocmask(SIG_BLOCK, &mask, mask_poll) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "sigprocmask: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  sigdelset(mask_poll, SIGCHLD);
+  if (signum != 0) {
+    sigdelset(mask_poll, signum);
+  }
+  for (int i = 1; forwarding && i < NSIG; i++) {
+    if (sigismember(iexec_forward_signals(), i) == 1) {
+      sigdelset(mask_poll, i);
+    }
+  }
+}
+
+static void iexec_wait_poll(const sigset_t *mask_poll) {
+  struct pollfd pfds[IEXEC_WAIT_MAX_FDS];
+  nfds_t count = (nfds_t)iexec_wait_fd_count;
+
+  for (nfds_t i = 0; i < count; i++) {
+    pfds[i].fd = iexec_wait_fds[i].fd;
+    pfds[i].events = POLLIN;
+    pfds[i].revents = 0;
+  }
+  int ret = iexec_ppoll(pfds, count, NULL, mask_poll);
+  if (ret == -1) {
+    if (errno == EINTR) {
       return;
     }
-    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "sigtimedwait: %s\n",
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "ppoll: %s\n",
                  iexec_strerror(iexec_errno()));
     iexec_exit(IEXEC_EXIT_FAILURE);
   }
+  for (nfds_t i = 0; i < count; i++) {
+    if (pfds[i].revents == 0) {
+      continue;
+    }
+    // handlers may add or remove entries, so look the fd up again
+    for (int j = 0; j < iexec_wait_fd_count; j++) {
+      if (iexec_wait_fds[j].fd == pfds[i].fd) {
+        iexec_wait_fds[j].handler(pfds[i].fd, iexec_wait_fds[j].arg);
+        break;
+      }
+    }
+  }
+}
+
+int iexec_wait_add_fd(int fd, iexec_wait_fd_handler_t handler, void *arg) {
+  if (iexec_wait_fd_count == IEXEC_WAIT_MAX_FDS) {
+    iexec_printf(IEXEC_PRINT_LEVEL_ERROR, "too many watched descriptors\n");
+    return -1;
+  }
+  iexec_wait_fds[iexec_wait_fd_count].fd = fd;
+  iexec_wait_fds[iexec_wait_fd_count].handler = handler;
+  iexec_wait_fds[iexec_wait_fd_count].arg = arg;
+  iexec_wait_fd_count++;
+  return 0;
+}
+
+void iexec_wait_remove_fd(int fd) {
+  for (int i = 0; i < iexec_wait_fd_count; i++) {
+    if (iexec_wait_fds[i].fd == fd) {
+      iexec_wait_fds[i] = iexec_wait_fds[--iexec_wait_fd_count];
+      return;
+    }
+  }
 }
 
 void iexec_wait_forever(void) {
   // just run as reaper if no command and running as init
   int status;
+  sigset_t mask_poll;
+  iexec_wait_prepare_signals(&mask_poll, 0);
   while (1) {
-    pid_t pid_reported = wait(&status);
+    pid_t pid_reported = iexec_wait_reap(&status, WNOHANG, NULL);
     if (pid_reported == -1) {
       if (errno == EINTR) {
         continue;
@@ -66,22 +169,71 @@ void iexec_wait_forever(void) {
                      iexec_strerror(iexec_errno()));
         iexec_exit(IEXEC_EXIT_FAILURE);
       }
+    } else if (pid_reported > 0) {
+      iexec_wait_reaped(pid_reported, status, 0);
+      continue;
     }
-    iexec_wait_for_sigchld_or_timeout();
+    iexec_wait_poll(&mask_poll);
   }
 }
 
+static pid_t iexec_wait_reload(pid_t pid_child) {
+  // forwarded signals are blocked outside ppoll, so forwarding switches to
+  // the new pid atomically
+  pid_t pid_new = iexec_reload_take_ready();
+  if (pid_new != -1) {
+    iexec_forward_retarget(pid_new);
+    iexec_reload_stop(pid_child);
+    IEXEC_TRACE2(reload, pid_child, pid_new);
+    iexec_journal_record(IEXEC_JOURNAL_RELOAD, pid_new, pid_child, 0);
+    iexec_watchdog_watch(pid_new);
+    iexec_timeout_watch(pid_new);
+    return pid_new;
+  }
+  // a request during a handover is served once the handover is over
+  if (!iexec_reload_pending() && iexec_reload_take()) {
+    iexec_reload_spawn();
+  }
+  return pid_child;
+}
+
+static pid_t iexec_wait_restart(pid_t pid_child) {
+  sigset_t mask;
+  sigset_t mask_saved;
+
+  // forwarding must never target the reaped instance
+  sigfillset(&mask);
+  iexec_sigprocmask(SIG_BLOCK, &mask, &mask_saved);
+  pid_t pid_new = iexec_watchdog_restart(pid_child);
+  if (pid_new != -1) {
+    iexec_forward_retarget(pid_new);
+    iexec_timeout_watch(pid_new);
+  }
+  iexec_sigprocmask(SIG_SETMASK, &mask_saved, NULL);
+  return pid_new;
+}
+
 void iexec_wait_for_children(pid_t pid_child) {
   int status;
   int status_child = -1;
-  iexec_install_signal_forwarders(pid_child);
+  iexec_timeout_limit_t limit_child = IEXEC_TIMEOUT_LIMIT_NONE;
+  struct rusage usage;
+  sigset_t mask_poll;
+  iexec_forward_start(pid_child);
+  iexec_reload_install();
+  iexec_wait_prepare_signals(&mask_poll, 1);
+  iexec_watchdog_watch(pid_child);
+  iexec_timeout_watch(pid_child);
   while (1) {
-    pid_t pid_reported = wait(&status);
+    pid_t pid_reported = iexec_wait_reap(&status, WNOHANG, &usage);
     if (pid_reported == -1) {
       if (errno == EINTR) {
         continue;
       }
       if (errno == ECHILD) {
+        if (limit_child != IEXEC_TIMEOUT_LIMIT_NONE) {
+          iexec_exit(IEXEC_EXIT_TIMEOUT);
+        }
         if (status_child != -1) {
           iexec_exit_from_wait_status(status_child);
         }
@@ -92,8 +244,59 @@ void iexec_wait_for_children(pid_t pid_child) {
                    iexec_strerror(iexec_errno()));
       iexec_exit(IEXEC_EXIT_FAILURE);
     }
+    if (pid_reported == 0) {
+      if (status_child == -1) {
+        pid_child = iexec_wait_reload(pid_child);
+      }
+      iexec_wait_poll(&mask_poll);
+      continue;
+    }
+    iexec_wait_reaped(pid_reported, status, pid_reported == pid_child);
+    iexec_timeout_limit_t limit =
+        iexec_timeout_reaped(pid_reported, status, &usage);
     if (pid_reported == pid_child) {
+      pid_t pid_new = iexec_wait_restart(pid_child);
+      if (pid_new != -1) {
+        pid_child = pid_new;
+        continue;
+      }
+      // the pid is free for reuse now, so only a live group is still targeted
+      iexec_forward_reaped(pid_reported);
+      iexec_reload_cancel();
       status_child = status;
+      limit_child = limit;
+      iexec_proctree_report_stragglers();
+    }
+  }
+}
+
+void iexec_wait_for_jobs(void) {
+  int status;
+  struct rusage usage;
+  sigset_t mask_poll;
+  iexec_wait_prepare_signals(&mask_poll, 1);
+  iexec_jobs_start();
+  while (1) {
+    pid_t pid_reported = iexec_wait_reap(&status, WNOHANG, &usage);
+    if (pid_reported == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != ECHILD) {
+        iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "waitpid: %s\n",
+                     iexec_strerror(iexec_errno()));
+        iexec_exit(IEXEC_EXIT_FAILURE);
+      }
+      // orphans of finished jobs are waited for too
+      if (iexec_jobs_finished()) {
+        iexec_jobs_exit();
+      }
+    } else if (pid_reported > 0) {
+      iexec_wait_reaped(pid_reported, status, 0);
+      iexec_jobs_reaped(pid_reported, status, &usage);
+      continue;
     }
+    iexec_wait_poll(&mask_poll);
+    iexec_jobs_take_signals();
   }
 }
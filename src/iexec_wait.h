@@ -3,6 +3,39 @@
 #include "iexec.h"
 #include <sys/types.h>
 
+/**
+ * @brief Handler for a descriptor watched by the wait loop
+ *
+ * @param fd readable (or hung up) descriptor
+ * @param arg argument given to iexec_wait_add_fd
+ */
+typedef void (*iexec_wait_fd_handler_t)(int fd, void *arg);
+
+/**
+ * @brief Watch a descriptor for readability in the wait loop
+ *
+ * @param fd descriptor to watch
+ * @param handler handler called when fd is readable
+ * @param arg handler argument
+ * @return 0 on success, -1 when the table is full (an error is printed);
+ *         callers in the running wait loop must carry on without the fd
+ */
+int iexec_wait_add_fd(int fd, iexec_wait_fd_handler_t handler, void *arg);
+
+/**
+ * @brief Stop watching a descriptor
+ *
+ * @param fd descriptor to forget
+ */
+void iexec_wait_remove_fd(int fd);
+
 void iexec_wait_forever(void) __attribute__((noreturn));
 
 void iexec_wait_for_children(pid_t pid_child) __attribute__((noreturn));
+
+/**
+ * @brief Run the job list of --jobs and reap jobs and orphans alike
+ *
+ * Exits once the list is exhausted and every descendant is reaped.
+ */
+void iexec_wait_for_jobs(void) __attribute__((noreturn));
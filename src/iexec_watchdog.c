@@ -0,0 +1,270 @@
+#include "iexec_watchdog.h"
+#include "iexec_command.h"
+#include "iexec_forward.h"
+#include "iexec_journal.h"
+#include "iexec_print.h"
+#include "iexec_process.h"
+#include "iexec_wait.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+typedef enum iexec_watchdog_state {
+  IEXEC_WATCHDOG_IDLE,
+  IEXEC_WATCHDOG_WAITING,
+  IEXEC_WATCHDOG_SIGNALED,
+  IEXEC_WATCHDOG_KILLED
+} iexec_watchdog_state_t;
+
+static int iexec_watchdog_interval = 0;
+static int iexec_watchdog_signal = SIGQUIT;
+static int iexec_watchdog_grace = 5;
+static int iexec_watchdog_restarting = 0;
+static int iexec_watchdog_fd = -1;       /* read end of the watched instance */
+static int iexec_watchdog_next_fd = -1;  /* read end of the last spawned one */
+static pid_t iexec_watchdog_next_pid = -1;
+static int iexec_watchdog_child_fd = -1; /* write end while spawning */
+static int iexec_watchdog_replaced_fd = -1; /* read end, no longer polled */
+static int iexec_watchdog_timer = -1;
+static iexec_watchdog_state_t iexec_watchdog_state = IEXEC_WATCHDOG_IDLE;
+static pid_t iexec_watchdog_pid = -1;
+static unsigned long long iexec_watchdog_heartbeats = 0;
+static unsigned long long iexec_watchdog_missed = 0;
+static unsigned long long iexec_watchdog_kills = 0;
+static unsigned long long iexec_watchdog_restarts = 0;
+
+static void iexec_watchdog_arm(int seconds) {
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = seconds;
+  if (timerfd_settime(iexec_watchdog_timer, 0, &spec, NULL) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "timerfd_settime: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+}
+
+static void iexec_watchdog_kill(void) {
+  iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+               "Watchdog: killing pid %d after missed heartbeat\n",
+               iexec_watchdog_pid);
+  iexec_forward_kill(iexec_watchdog_pid, SIGKILL);
+  iexec_journal_record(IEXEC_JOURNAL_WATCHDOG, iexec_watchdog_pid, SIGKILL,
+                       (int32_t)iexec_watchdog_missed);
+  iexec_watchdog_kills++;
+  iexec_watchdog_state = IEXEC_WATCHDOG_KILLED;
+  iexec_watchdog_arm(0);
+}
+
+static void iexec_watchdog_on_timer(int fd, void *arg) {
+  uint64_t expirations;
+  (void)arg;
+  if (read(fd, &expirations, sizeof(expirations)) == -1) {
+    return;
+  }
+  switch (iexec_watchdog_state) {
+  case IEXEC_WATCHDOG_WAITING:
+    iexec_watchdog_missed++;
+    if (iexec_watchdog_signal == 0) {
+      iexec_watchdog_kill();
+      break;
+    }
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+                 "Watchdog: pid %d missed heartbeat, sending SIG%s\n",
+                 iexec_watchdog_pid, sigabbrev_np(iexec_watchdog_signal));
+    iexec_forward_kill(iexec_watchdog_pid, iexec_watchdog_signal);
+    iexec_journal_record(IEXEC_JOURNAL_WATCHDOG, iexec_watchdog_pid,
+                         iexec_watchdog_signal,
+                         (int32_t)iexec_watchdog_missed);
+    iexec_watchdog_state = IEXEC_WATCHDOG_SIGNALED;
+    iexec_watchdog_arm(iexec_watchdog_grace);
+    break;
+  case IEXEC_WATCHDOG_SIGNALED:
+    iexec_watchdog_kill();
+    break;
+  default:
+    break;
+  }
+}
+
+static void iexec_watchdog_close(int *fd) {
+  if (*fd == -1) {
+    return;
+  }
+  iexec_wait_remove_fd(*fd);
+  close(*fd);
+  *fd = -1;
+}
+
+static void iexec_watchdog_on_heartbeat(int fd, void *arg) {
+  char buf[256];
+  ssize_t len;
+  int beat = 0;
+  int current = fd == iexec_watchdog_fd;
+  (void)arg;
+  // a burst of heartbeats counts as one
+  while ((len = read(fd, buf, sizeof(buf))) > 0) {
+    beat = 1;
+  }
+  if (len == 0) {
+    // every process holding the write end is gone
+    iexec_watchdog_close(current ? &iexec_watchdog_fd
+                                 : &iexec_watchdog_next_fd);
+  }
+  // heartbeats of an instance that is not watched yet do not count
+  if (!current || !beat) {
+    return;
+  }
+  iexec_watchdog_heartbeats++;
+  if (iexec_watchdog_state == IEXEC_WATCHDOG_WAITING ||
+      iexec_watchdog_state == IEXEC_WATCHDOG_SIGNALED) {
+    iexec_watchdog_state = IEXEC_WATCHDOG_WAITING;
+    iexec_watchdog_arm(iexec_watchdog_interval);
+  }
+}
+
+void iexec_watchdog_configure(const iexec_option_t *ctx) {
+  if (ctx->watchdog_interval == 0) {
+    return;
+  }
+  iexec_watchdog_interval = ctx->watchdog_interval;
+  iexec_watchdog_signal = ctx->watchdog_signal;
+  iexec_watchdog_grace = ctx->watchdog_grace;
+  iexec_watchdog_restarting = ctx->watchdog_restart;
+
+  iexec_watchdog_timer =
+      timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (iexec_watchdog_timer == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "timerfd_create: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  if (iexec_wait_add_fd(iexec_watchdog_timer, iexec_watchdog_on_timer, NULL) ==
+      -1) {
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+}
+
+void iexec_watchdog_prepare(void) {
+  int fds[2];
+  if (iexec_watchdog_timer == -1) {
+    return;
+  }
+  // non-blocking on both ends, so a full pipe never stalls a healthy child
+  if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "pipe2: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  // an earlier candidate that was never watched loses its pipe
+  iexec_watchdog_close(&iexec_watchdog_next_fd);
+  iexec_watchdog_next_pid = -1;
+  if (iexec_wait_add_fd(fds[0], iexec_watchdog_on_heartbeat, NULL) == -1) {
+    close(fds[0]);
+    close(fds[1]);
+    return;
+  }
+  iexec_watchdog_next_fd = fds[0];
+  iexec_watchdog_child_fd = fds[1];
+}
+
+void iexec_watchdog_spawned(pid_t pid) {
+  if (iexec_watchdog_child_fd == -1) {
+    return;
+  }
+  close(iexec_watchdog_child_fd);
+  iexec_watchdog_child_fd = -1;
+  iexec_watchdog_next_pid = pid;
+}
+
+void iexec_watchdog_child(void) {
+  char value[24];
+  int fd = iexec_watchdog_child_fd;
+  if (fd == -1) {
+    return;
+  }
+  if (fcntl(fd, F_SETFD, 0) == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_FATAL, "fcntl: %s\n",
+                 iexec_strerror(iexec_errno()));
+    iexec_exit(IEXEC_EXIT_FAILURE);
+  }
+  snprintf(value, sizeof(value), "%d", fd);
+  setenv("IEXEC_WATCHDOG_FD", value, 1);
+  snprintf(value, sizeof(value), "%lld",
+           (long long)iexec_watchdog_interval * 1000000);
+  setenv("IEXEC_WATCHDOG_USEC", value, 1);
+}
+
+void iexec_watchdog_watch(pid_t pid) {
+  if (iexec_watchdog_timer == -1) {
+    return;
+  }
+  // orphans of a replaced instance may hold its pipe for good, so it is no
+  // longer polled; it stays open until the next handover, so the instance
+  // does not get SIGPIPE while it stops, and full writes fail with EAGAIN
+  if (iexec_watchdog_replaced_fd != -1) {
+    close(iexec_watchdog_replaced_fd);
+  }
+  iexec_watchdog_replaced_fd = iexec_watchdog_fd;
+  if (iexec_watchdog_fd != -1) {
+    iexec_wait_remove_fd(iexec_watchdog_fd);
+    iexec_watchdog_fd = -1;
+  }
+  if (pid != iexec_watchdog_next_pid || iexec_watchdog_next_fd == -1) {
+    iexec_printf(IEXEC_PRINT_LEVEL_WARNING,
+                 "Watchdog: pid %d has no heartbeat pipe, not watched\n",
+                 pid);
+    iexec_watchdog_pid = -1;
+    iexec_watchdog_state = IEXEC_WATCHDOG_IDLE;
+    iexec_watchdog_arm(0);
+    return;
+  }
+  iexec_watchdog_fd = iexec_watchdog_next_fd;
+  iexec_watchdog_next_fd = -1;
+  iexec_watchdog_next_pid = -1;
+  iexec_watchdog_pid = pid;
+  iexec_watchdog_state = IEXEC_WATCHDOG_WAITING;
+  iexec_watchdog_arm(iexec_watchdog_interval);
+}
+
+pid_t iexec_watchdog_restart(pid_t pid) {
+  if (iexec_watchdog_timer == -1 || pid != iexec_watchdog_pid) {
+    return -1;
+  }
+  int killed = iexec_watchdog_state == IEXEC_WATCHDOG_KILLED;
+  iexec_watchdog_state = IEXEC_WATCHDOG_IDLE;
+  iexec_watchdog_arm(0);
+  if (!killed || !iexec_watchdog_restarting) {
+    return -1;
+  }
+  pid_t pid_new = iexec_command_spawn(NULL, NULL);
+  if (pid_new == -1) {
+    return -1;
+  }
+  iexec_printf(IEXEC_PRINT_LEVEL_WARNING, "Watchdog: restarted as pid %d\n",
+               pid_new);
+  iexec_watchdog_restarts++;
+  iexec_watchdog_watch(pid_new);
+  return pid_new;
+}
+
+size_t iexec_watchdog_format_stats(char *buf, size_t size) {
+  int len = snprintf(buf, size,
+                     "watchdog_interval %d\n"
+                     "watchdog_heartbeats_total %llu\n"
+                     "watchdog_missed_total %llu\n"
+                     "watchdog_kills_total %llu\n"
+                     "watchdog_restarts_total %llu\n",
+                     iexec_watchdog_interval, iexec_watchdog_heartbeats,
+                     iexec_watchdog_missed, iexec_watchdog_kills,
+                     iexec_watchdog_restarts);
+  if (len < 0) {
+    return 0;
+  }
+  return (size_t)len < size ? (size_t)len : size - 1;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "iexec.h"
+#include "iexec_option.h"
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * @brief Create the heartbeat timer when --watchdog is set
+ *
+ * The timer and the heartbeat pipes are served by the wait loop.
+ *
+ * @param ctx iexec_option_t context
+ */
+void iexec_watchdog_configure(const iexec_option_t *ctx);
+
+/**
+ * @brief Create the heartbeat pipe of a main command instance about to fork
+ *
+ * Every instance gets its own pipe, so heartbeats of a replaced instance, or
+ * of orphans holding its descriptor, never count for the new one.
+ */
+void iexec_watchdog_prepare(void);
+
+/**
+ * @brief Close the write end of the heartbeat pipe in the parent after fork
+ *
+ * @param pid new instance pid, or -1 if fork failed
+ */
+void iexec_watchdog_spawned(pid_t pid);
+
+/**
+ * @brief Pass the heartbeat pipe to a main command instance
+ *
+ * Called in the child before exec. Sets IEXEC_WATCHDOG_FD and
+ * IEXEC_WATCHDOG_USEC when the watchdog is enabled.
+ */
+void iexec_watchdog_child(void);
+
+/**
+ * @brief Start expecting heartbeats from a new main child
+ *
+ * The heartbeat pipe of the instance replaces the one watched so far.
+ *
+ * @param pid main child pid
+ */
+void iexec_watchdog_watch(pid_t pid);
+
+/**
+ * @brief Handle the exit of the watched main child
+ *
+ * When the watchdog killed the child and --watchdog-action=restart is set, a
+ * new instance is spawned and watched.
+ *
+ * @param pid reaped main child pid
+ * @return pid of the new instance, or -1 if iexec should exit
+ */
+pid_t iexec_watchdog_restart(pid_t pid);
+
+/**
+ * @brief Format watchdog metrics as "name value" lines
+ *
+ * @param buf output buffer
+ * @param size output buffer size
+ * @return number of bytes written (excluding the terminating NUL)
+ */
+size_t iexec_watchdog_format_stats(char *buf, size_t size);
@@ -0,0 +1,89 @@
+#!/bin/sh
+
+set -u
+
+if [ "${IEXEC_BENCH:-0}" != 1 ]; then
+  echo "SKIP: set IEXEC_BENCH=1 to run benchmarks"
+  exit 77
+fi
+
+IEXEC=${IEXEC_TEST_BINARY:-./src/iexec}
+ROUNDS=${IEXEC_BENCH_ROUNDS:-5}
+# the command must print a line once it is ready to serve
+COMMAND=${IEXEC_BENCH_COMMAND:-'echo ready'}
+
+fail() {
+  echo "FAIL: $*" >&2
+  exit 1
+}
+
+now_us() {
+  echo $(($(date +%s%N) / 1000))
+}
+
+drop_caches() {
+  sync
+  echo 3 >/proc/sys/vm/drop_caches 2>/dev/null
+}
+
+if drop_caches; then
+  cold=1
+else
+  echo "NOTE: cannot drop page caches, measuring warm starts only"
+  cold=0
+fi
+
+# time from starting iexec until the command prints its first line
+time_to_first_line() {
+  start=$(now_us)
+  "$IEXEC" "$@" /bin/sh -c "$COMMAND" | {
+    read -r line || fail "command printed nothing: $COMMAND"
+    echo $(($(now_us) - start))
+    cat >/dev/null
+  }
+}
+
+for mode in plain prewarm; do
+  total=0
+  round=0
+  while [ "$round" -lt "$ROUNDS" ]; do
+    if [ "$cold" -eq 1 ]; then
+      drop_caches
+    fi
+    if [ "$mode" = prewarm ]; then
+      elapsed=$(time_to_first_line --prewarm) || exit 1
+    else
+      elapsed=$(time_to_first_line) || exit 1
+    fi
+    total=$((total + elapsed))
+    round=$((round + 1))
+  done
+  echo "time-to-first-line $mode: $((total / ROUNDS)) us (rounds=$ROUNDS cold=$cold)"
+done
+
+# batch throughput of the job runner against xargs -P, both under iexec
+JOBS=${IEXEC_BENCH_JOBS:-2000}
+PARALLEL=${IEXEC_BENCH_PARALLEL:-$(nproc)}
+args=$(mktemp) || exit 1
+trap 'rm -f "$args"' EXIT
+seq 1 "$JOBS" >"$args"
+
+for mode in xargs jobs; do
+  total=0
+  round=0
+  while [ "$round" -lt "$ROUNDS" ]; do
+    start=$(now_us)
+    if [ "$mode" = jobs ]; then
+      "$IEXEC" --jobs="$args" --parallel="$PARALLEL" --job-log=/dev/null \
+        /bin/true || fail "job runner failed"
+    else
+      "$IEXEC" xargs -P "$PARALLEL" -n 1 /bin/true <"$args" ||
+        fail "xargs failed"
+    fi
+    total=$((total + $(now_us) - start))
+    round=$((round + 1))
+  done
+  elapsed=$((total / ROUNDS))
+  echo "batch $mode: $elapsed us, $((JOBS * 1000000 / elapsed)) jobs/s" \
+    "(jobs=$JOBS parallel=$PARALLEL rounds=$ROUNDS)"
+done
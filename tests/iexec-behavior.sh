@@ -3,6 +3,7 @@
 set -u
 
 IEXEC=${IEXEC_TEST_BINARY:-./src/iexec}
+IEXEC_EVENTS=${IEXEC_EVENTS_BINARY:-./src/iexec-events}
 
 fail() {
   echo "FAIL: $*" >&2
@@ -137,3 +138,517 @@ fi
 if ! grep -q "done" "$orphan_file"; then
   fail "iexec exited before reaping orphaned child"
 fi
+
+reload_log=$tmpdir/reload.log
+"$IEXEC" --reload --reload-timeout=5 /bin/sh -c '
+  if [ -n "${IEXEC_READY_FD:-}" ]; then
+    trap '\''echo new-term >> "$1"; exit 42'\'' TERM
+    echo new-start >> "$1"
+    eval "echo ready >&$IEXEC_READY_FD"
+  else
+    trap '\''echo old-term >> "$1"; exit 0'\'' TERM
+    echo old-start >> "$1"
+  fi
+  while :; do sleep 1 & wait $!; done' sh "$reload_log" &
+pid=$!
+(sleep 10; kill -KILL "$pid" 2>/dev/null || true) &
+watchdog_pid=$!
+sleep 1
+kill -HUP "$pid"
+sleep 2
+kill -TERM "$pid"
+wait "$pid"
+status=$?
+kill "$watchdog_pid" 2>/dev/null || true
+watchdog_pid=
+if [ "$status" -ne 42 ]; then
+  fail "expected reloaded instance status 42, got $status"
+fi
+if [ "$(cat "$reload_log")" != "$(printf 'old-start\nnew-start\nold-term\nnew-term')" ]; then
+  fail "unexpected reload handover order: $(cat "$reload_log")"
+fi
+
+rollback_log=$tmpdir/rollback.log
+"$IEXEC" --reload --reload-timeout=5 /bin/sh -c '
+  if [ -n "${IEXEC_READY_FD:-}" ]; then
+    echo new-fail >> "$1"
+    exit 3
+  fi
+  trap '\''echo old-term >> "$1"; exit 43'\'' TERM
+  while :; do sleep 1 & wait $!; done' sh "$rollback_log" 2>/dev/null &
+pid=$!
+(sleep 10; kill -KILL "$pid" 2>/dev/null || true) &
+watchdog_pid=$!
+sleep 1
+kill -HUP "$pid"
+sleep 1
+kill -TERM "$pid"
+wait "$pid"
+status=$?
+kill "$watchdog_pid" 2>/dev/null || true
+watchdog_pid=
+if [ "$status" -ne 43 ]; then
+  fail "expected rolled back instance status 43, got $status"
+fi
+if [ "$(cat "$rollback_log")" != "$(printf 'new-fail\nold-term')" ]; then
+  fail "unexpected reload rollback order: $(cat "$rollback_log")"
+fi
+
+# a candidate that exits right after becoming ready is never promoted; iexec
+# is stopped meanwhile, so it sees the ready byte and the exit together
+ready_exit_log=$tmpdir/ready-exit.log
+"$IEXEC" --reload --reload-timeout=5 /bin/sh -c '
+  if [ -n "${IEXEC_READY_FD:-}" ]; then
+    kill -STOP $PPID
+    (sleep 0.5; kill -CONT $PPID) &
+    echo new-ready >> "$1"
+    printf x >"/dev/fd/$IEXEC_READY_FD"
+    exit 7
+  fi
+  trap '\''echo old-term >> "$1"; exit 45'\'' TERM
+  while :; do sleep 1 & wait $!; done' sh "$ready_exit_log" 2>/dev/null &
+pid=$!
+(sleep 10; kill -KILL "$pid" 2>/dev/null || true) &
+watchdog_pid=$!
+sleep 1
+kill -HUP "$pid"
+sleep 2
+kill -TERM "$pid"
+wait "$pid"
+status=$?
+kill "$watchdog_pid" 2>/dev/null || true
+watchdog_pid=
+if [ "$status" -ne 45 ]; then
+  fail "expected status 45 after a candidate exited once ready, got $status"
+fi
+if [ "$(cat "$ready_exit_log")" != "$(printf 'new-ready\nold-term')" ]; then
+  fail "unexpected rollback of an exited candidate: $(cat "$ready_exit_log")"
+fi
+
+# a shutdown signal during a handover reaches the current instance at once
+pending_log=$tmpdir/pending.log
+"$IEXEC" --reload --reload-timeout=30 /bin/sh -c '
+  if [ -n "${IEXEC_READY_FD:-}" ]; then
+    echo new-start >> "$1"
+    while :; do sleep 1 & wait $!; done
+  fi
+  trap '\''echo old-term >> "$1"; exit 44'\'' TERM
+  while :; do sleep 1 & wait $!; done' sh "$pending_log" 2>/dev/null &
+pid=$!
+(sleep 10; kill -KILL "$pid" 2>/dev/null || true) &
+watchdog_pid=$!
+sleep 1
+kill -HUP "$pid"
+sleep 1
+kill -TERM "$pid"
+wait "$pid"
+status=$?
+kill "$watchdog_pid" 2>/dev/null || true
+watchdog_pid=
+if [ "$status" -ne 44 ]; then
+  fail "expected status 44 for a shutdown during a handover, got $status"
+fi
+if [ "$(cat "$pending_log")" != "$(printf 'new-start\nold-term')" ]; then
+  fail "unexpected shutdown during a handover: $(cat "$pending_log")"
+fi
+
+journal=$tmpdir/journal
+run_expect_status 5 --journal="$journal" /bin/sh -c '(sleep 1; exit 3) & exit 5'
+run_expect_status 127 --journal="$journal" "$tmpdir/no-such-command" 2>/dev/null
+"$IEXEC_EVENTS" "$journal" >"$tmpdir/journal.out"
+status=$?
+if [ "$status" -ne 0 ]; then
+  fail "expected iexec-events status 0, got $status"
+fi
+for event in "start pid=" "spawn pid=" "exited=3 main=0" "exited=5 main=1" \
+    "exit status=5" "exec-fail pid=" "exited=127 main=1" "exit status=127"; do
+  if ! grep -q -- "$event" "$tmpdir/journal.out"; then
+    fail "journal is missing event: $event"
+  fi
+done
+if [ "$(grep -c " start pid=" "$tmpdir/journal.out")" -ne 2 ]; then
+  fail "journal must keep events across runs"
+fi
+
+control_socket=$tmpdir/control.sock
+"$IEXEC" --control-socket="$control_socket" /bin/sh -c \
+  'trap '\''exit 0'\'' TERM; while :; do sleep 1 & wait $!; done' &
+pid=$!
+(sleep 10; kill -KILL "$pid" 2>/dev/null || true) &
+watchdog_pid=$!
+sleep 1
+attach_output=$(echo attached-input | "$IEXEC" --attach="$control_socket" \
+  FOO=bar /bin/sh -c 'read line; echo "$line $FOO $PPID"; exit 9')
+status=$?
+if [ "$status" -ne 9 ]; then
+  fail "expected attached command status 9, got $status"
+fi
+if [ "$attach_output" != "attached-input bar $pid" ]; then
+  fail "attached command must share stdio and run as iexec child: $attach_output"
+fi
+"$IEXEC" --attach="$control_socket" /bin/sh -c 'kill -TERM $$'
+status=$?
+if [ "$status" -ne 143 ]; then
+  fail "expected attached signal status 143, got $status"
+fi
+kill -TERM "$pid"
+wait "$pid"
+status=$?
+kill "$watchdog_pid" 2>/dev/null || true
+watchdog_pid=
+if [ "$status" -ne 0 ]; then
+  fail "expected control socket server status 0, got $status"
+fi
+
+# clients that connect and send nothing must not stall the wait loop
+if command -v python3 >/dev/null 2>&1; then
+  silent_socket=$tmpdir/silent.sock
+  "$IEXEC" --control-socket="$silent_socket" /bin/sh -c \
+    'trap '\''exit 6'\'' TERM; while :; do sleep 1 & wait $!; done' \
+    2>/dev/null &
+  pid=$!
+  sleep 0.5
+  python3 -c '
+import socket, sys, time
+conns = []
+for i in range(16):
+    conn = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    conn.connect(sys.argv[1])
+    conns.append(conn)
+time.sleep(10)
+' "$silent_socket" &
+  silent_pid=$!
+  sleep 0.5
+  start=$(date +%s)
+  "$IEXEC" --attach="$silent_socket" /bin/true
+  status=$?
+  elapsed=$(($(date +%s) - start))
+  kill "$silent_pid" 2>/dev/null || true
+  wait "$silent_pid" 2>/dev/null
+  kill -TERM "$pid"
+  wait "$pid"
+  if [ "$status" -ne 0 ]; then
+    fail "expected attach status 0 with silent control clients, got $status"
+  fi
+  if [ "$elapsed" -ge 3 ]; then
+    fail "silent control clients stalled the wait loop for $elapsed seconds"
+  fi
+fi
+
+"$IEXEC" --attach="$tmpdir/no-such-socket" /bin/true 2>"$tmpdir/attach.err"
+status=$?
+if [ "$status" -ne 1 ]; then
+  fail "expected missing control socket status 1, got $status"
+fi
+if ! grep -q "control socket" "$tmpdir/attach.err"; then
+  fail "missing control socket diagnostic"
+fi
+
+stats_socket=$tmpdir/stats.sock
+"$IEXEC" --track-tree=proc --control-socket="$stats_socket" /bin/sh -c \
+  'sleep 3 & sleep 2; (sleep 1 &); exit 0' 2>"$tmpdir/track-tree.err" &
+pid=$!
+sleep 1
+"$IEXEC" --stats="$stats_socket" >"$tmpdir/stats.out"
+status=$?
+if [ "$status" -ne 0 ]; then
+  fail "expected --stats status 0, got $status"
+fi
+wait "$pid"
+status=$?
+if [ "$status" -ne 0 ]; then
+  fail "expected tracked tree status 0, got $status"
+fi
+if ! grep -q "^tree_mode proc$" "$tmpdir/stats.out" ||
+    ! grep -q "^tree_live 3$" "$tmpdir/stats.out"; then
+  fail "unexpected process tree stats: $(cat "$tmpdir/stats.out")"
+fi
+if ! grep -q "straggler pid .* (sleep)" "$tmpdir/track-tree.err"; then
+  fail "missing straggler report after main child exit"
+fi
+
+# reaped children must not be reported, whichever mode tracks the tree
+for mode in proc netlink; do
+  "$IEXEC" --track-tree="$mode" /bin/true 2>"$tmpdir/track-mode.err"
+  if grep -q "unavailable" "$tmpdir/track-mode.err"; then
+    continue
+  fi
+  "$IEXEC" --track-tree="$mode" /bin/sh -c 'sleep 2 & sleep 0.5; exit 0' \
+    2>"$tmpdir/track-mode.err"
+  if ! grep -q "^Warning: 1 descendants still running" \
+      "$tmpdir/track-mode.err" ||
+      ! grep -q "straggler pid .* (sleep)" "$tmpdir/track-mode.err"; then
+    fail "unexpected $mode straggler report: $(cat "$tmpdir/track-mode.err")"
+  fi
+done
+
+cgroup_env=$(GOMAXPROCS=7 "$IEXEC" --cgroup-env --cpu-rounding=floor \
+  OMP_NUM_THREADS=2 /bin/sh -c \
+  'echo "$IEXEC_CPUS $GOMAXPROCS $OMP_NUM_THREADS $MALLOC_ARENA_MAX"')
+set -- $cgroup_env
+if [ "$#" -ne 4 ] || [ "$1" -lt 1 ] || [ "$1" -gt "$(nproc)" ]; then
+  fail "unexpected cgroup sizing: $cgroup_env"
+fi
+if [ "$2" != 7 ] || [ "$3" != 2 ] || [ "$4" != "$1" ]; then
+  fail "user-set sizing variables must take precedence: $cgroup_env"
+fi
+cgroup_env=$("$IEXEC" /bin/sh -c 'echo "${IEXEC_CPUS-unset}"')
+if [ "$cgroup_env" != unset ]; then
+  fail "sizing variables must only be exported with --cgroup-env"
+fi
+run_expect_status 1 --cpu-rounding=up /bin/true 2>/dev/null
+# parsing --cpu-rounding must not reset options given before it
+run_expect_status 0 --nice=5 --cpu-rounding=ceil \
+  /bin/sh -c '[ $(ps -o ni= -p $PPID) -eq 5 ]' 2>/dev/null
+run_expect_status 0 --watchdog=60 --cpu-rounding=ceil \
+  /bin/sh -c 'test -n "$IEXEC_WATCHDOG_FD"'
+
+# orphans must still be reaped promptly while CPU hogs saturate the quota
+harden_output=$("$IEXEC" --harden /bin/sh -c '
+  echo "$(cat /proc/self/oom_score_adj) $(ps -o ni= -p $$)"
+  hogs=
+  for i in 1 2 3 4; do
+    (while :; do :; done) &
+    hogs="$hogs $!"
+  done
+  for i in 1 2 3 4 5; do
+    (sleep 0.1 &)
+  done
+  sleep 1
+  for stat in /proc/[0-9]*/stat; do
+    read -r pid comm state ppid rest <"$stat" 2>/dev/null || continue
+    if [ "$state" = Z ] && [ "$ppid" = "$PPID" ]; then
+      echo "zombie $pid"
+    fi
+  done
+  kill $hogs
+' 2>"$tmpdir/harden.err")
+status=$?
+if [ "$status" -ne 0 ]; then
+  fail "expected hardened status 0, got $status"
+fi
+expected="$(cat /proc/self/oom_score_adj) $(ps -o ni= -p $$ | tr -d ' ')"
+set -- $harden_output
+if [ "$1 $2" != "$expected" ]; then
+  fail "hardening must be undone for the child: $1 $2, expected $expected"
+fi
+if echo "$harden_output" | grep -q zombie; then
+  fail "orphans were not reaped under CPU stress: $harden_output"
+fi
+run_expect_status 1 --nice=-21 /bin/true 2>/dev/null
+
+printf '%s\n' '# extra files' /bin/sh "$tmpdir/no-such-file" >"$tmpdir/prewarm.list"
+run_expect_status 0 -v --prewarm-list="$tmpdir/prewarm.list" PATH=/bin:/usr/bin \
+  sh -c 'exit 0' 2>"$tmpdir/prewarm.err"
+if ! grep -q "^prewarm: [1-9][0-9]* files" "$tmpdir/prewarm.err" ||
+    ! grep -q "skip $tmpdir/no-such-file" "$tmpdir/prewarm.err"; then
+  fail "unexpected prewarm report: $(cat "$tmpdir/prewarm.err")"
+fi
+run_expect_status 127 --prewarm "$tmpdir/no-such-command" 2>/dev/null
+
+watchdog_journal=$tmpdir/watchdog.journal
+run_expect_status 137 --watchdog=1 --watchdog-signal=USR1 --watchdog-grace=1 \
+  --journal="$watchdog_journal" /bin/sh -c \
+  'trap "" USR1; echo >&"$IEXEC_WATCHDOG_FD"; exec sleep 30' \
+  2>"$tmpdir/watchdog.err"
+if ! grep -q "missed heartbeat, sending SIGUSR1" "$tmpdir/watchdog.err" ||
+    ! grep -q "killing pid" "$tmpdir/watchdog.err"; then
+  fail "watchdog must escalate to SIGKILL: $(cat "$tmpdir/watchdog.err")"
+fi
+"$IEXEC_EVENTS" "$watchdog_journal" >"$tmpdir/watchdog.out"
+if ! grep -q "watchdog pid=.* signal=USR1 missed=1" "$tmpdir/watchdog.out" ||
+    ! grep -q "watchdog pid=.* signal=KILL missed=1" "$tmpdir/watchdog.out"; then
+  fail "journal is missing watchdog events: $(cat "$tmpdir/watchdog.out")"
+fi
+
+marker=$tmpdir/watchdog.marker
+run_expect_status 4 --watchdog=1 --watchdog-signal=NONE \
+  --watchdog-action=restart /bin/sh -c \
+  'if [ -e "$0" ]; then exit 4; fi; : >"$0"; exec sleep 30' "$marker" \
+  2>"$tmpdir/watchdog-restart.err"
+if ! grep -q "restarted as pid" "$tmpdir/watchdog-restart.err"; then
+  fail "watchdog must restart a killed child: $(cat "$tmpdir/watchdog-restart.err")"
+fi
+
+# heartbeats of a replaced instance's orphans must not keep a hung one alive
+count=$tmpdir/watchdog.count
+run_expect_status 4 --watchdog=1 --watchdog-signal=NONE \
+  --watchdog-action=restart --timeout=8 /bin/sh -c '
+  n=$(($(cat "$0" 2>/dev/null || echo 0) + 1))
+  echo "$n" >"$0"
+  case $n in
+    1)
+      (sleep 1.5; i=0; while [ "$(cat "$0")" -lt 3 ] && [ "$i" -lt 40 ]; do
+        echo >&"$IEXEC_WATCHDOG_FD"; sleep 0.3; i=$((i + 1)); done) &
+      exec sleep 30 ;;
+    2) exec sleep 30 ;;
+  esac
+  exit 4' "$count" 2>/dev/null
+
+# orphans holding the pipes of replaced instances do not use up the wait loop
+orphans_stop=$tmpdir/orphans.stop
+"$IEXEC" --reload --watchdog=600 /bin/sh -c '
+  (while [ ! -e "$0" ]; do sleep 0.1; done) &
+  if [ -n "${IEXEC_READY_FD:-}" ]; then
+    printf x >"/dev/fd/$IEXEC_READY_FD"
+  fi
+  trap "exit 46" TERM
+  while :; do sleep 1 & wait $!; done' "$orphans_stop" 2>/dev/null &
+pid=$!
+(sleep 30; kill -KILL "$pid" 2>/dev/null || true) &
+watchdog_pid=$!
+sleep 0.5
+i=0
+while [ "$i" -lt 40 ] && kill -HUP "$pid" 2>/dev/null; do
+  sleep 0.1
+  i=$((i + 1))
+done
+touch "$orphans_stop"
+kill -TERM "$pid" 2>/dev/null
+wait "$pid"
+status=$?
+kill "$watchdog_pid" 2>/dev/null || true
+watchdog_pid=
+if [ "$i" -ne 40 ] || [ "$status" -ne 46 ]; then
+  fail "expected 40 reloads and status 46 with orphans holding heartbeat pipes, got $i and $status"
+fi
+
+watchdog_socket=$tmpdir/watchdog.sock
+"$IEXEC" --watchdog=1 --control-socket="$watchdog_socket" /bin/sh -c \
+  'for i in 1 2 3 4 5 6; do echo >&"$IEXEC_WATCHDOG_FD"; sleep 0.5; done' \
+  2>"$tmpdir/watchdog-healthy.err" &
+pid=$!
+sleep 2
+"$IEXEC" --stats="$watchdog_socket" >"$tmpdir/watchdog-stats.out"
+wait "$pid"
+status=$?
+if [ "$status" -ne 0 ] || [ -s "$tmpdir/watchdog-healthy.err" ]; then
+  fail "healthy heartbeats must not trigger the watchdog: $status $(cat "$tmpdir/watchdog-healthy.err")"
+fi
+if ! grep -q "^watchdog_missed_total 0$" "$tmpdir/watchdog-stats.out" ||
+    ! grep -q "^watchdog_heartbeats_total [1-9]" "$tmpdir/watchdog-stats.out"; then
+  fail "unexpected watchdog stats: $(cat "$tmpdir/watchdog-stats.out")"
+fi
+
+# a group forward reaches the workers of a master that does not relay it
+"$IEXEC" --forward=group /bin/sh -c 'sleep 30 & sleep 30 & wait' &
+pid=$!
+(sleep 10; kill -KILL "$pid" 2>/dev/null || true) &
+watchdog_pid=$!
+sleep 1
+kill -TERM "$pid"
+wait "$pid"
+status=$?
+kill "$watchdog_pid" 2>/dev/null || true
+watchdog_pid=
+if [ "$status" -ne 143 ]; then
+  fail "expected group forward to stop the workers with status 143, got $status"
+fi
+
+# the group keeps receiving forwarded signals after its master has exited
+"$IEXEC" --forward=group /bin/sh -c 'sleep 30 & sleep 30 & exit 3' &
+pid=$!
+(sleep 10; kill -KILL "$pid" 2>/dev/null || true) &
+watchdog_pid=$!
+sleep 1
+kill -TERM "$pid"
+wait "$pid"
+status=$?
+kill "$watchdog_pid" 2>/dev/null || true
+watchdog_pid=
+if [ "$status" -ne 3 ]; then
+  fail "expected the orphaned workers to be stopped with status 3, got $status"
+fi
+run_expect_status 0 --forward=group /bin/sh -c \
+  'test "$(ps -o pgid= -p $$)" -eq $$'
+run_expect_status 0 --forward=session /bin/sh -c \
+  'test "$(ps -o sid= -p $$)" -eq $$'
+run_expect_status 3 --forward-all /bin/sh -c \
+  'trap "exit 3" USR1; kill -USR1 $PPID; while :; do sleep 0.1; done'
+run_expect_status 4 --signal-rewrite=TERM:USR2 /bin/sh -c \
+  'trap "exit 4" USR2; trap "exit 5" TERM; kill -TERM $PPID;
+   while :; do sleep 0.1; done'
+run_expect_status 1 --forward=pgrp /bin/true 2>/dev/null
+run_expect_status 1 --signal-rewrite=TERM /bin/true 2>/dev/null
+run_expect_status 1 --signal-rewrite=KILL:TERM /bin/true 2>/dev/null
+run_expect_status 1 --signal-rewrite=CHLD:TERM /bin/true 2>/dev/null
+run_expect_status 1 --reload --signal-rewrite=HUP:QUIT /bin/true 2>/dev/null
+run_expect_status 1 --signal-rewrite=USR1:QUIT --reload=USR1 /bin/true \
+  2>/dev/null
+run_expect_status 0 --reload --signal-rewrite=TERM:QUIT /bin/true
+
+# job runner: results, template arguments, fail-fast and orphans
+jobs_log=$tmpdir/jobs.log
+printf '%s\n' 'sh -c "exit 3"' '' 'echo "a b"  c\ d' |
+  "$IEXEC" --jobs=- --parallel=2 --job-log="$jobs_log" >"$tmpdir/jobs.out"
+status=$?
+if [ "$status" -ne 3 ]; then
+  fail "expected the first failed job's status 3, got $status"
+fi
+if [ "$(wc -l <"$jobs_log")" -ne 2 ] ||
+    ! grep -q '^job=1 pid=[0-9]* exit=3 wall=[0-9.]* user=[0-9.]* sys=[0-9.]* maxrss=[0-9]* command=sh -c exit 3$' "$jobs_log" ||
+    ! grep -q '^job=2 .* exit=0 .* command=echo a b c d$' "$jobs_log" ||
+    [ "$(cat "$tmpdir/jobs.out")" != "a b c d" ]; then
+  fail "unexpected job results: $(cat "$jobs_log" "$tmpdir/jobs.out")"
+fi
+printf 'a b\0c\0' | "$IEXEC" --jobs=- --null --parallel=1 \
+  --job-log=/dev/null /bin/sh -c 'echo "[$1]"' sh >"$tmpdir/jobs.out"
+if [ "$(cat "$tmpdir/jobs.out")" != "$(printf '[a b]\n[c]')" ]; then
+  fail "unexpected NUL-separated job output: $(cat "$tmpdir/jobs.out")"
+fi
+printf '%s\n' 'sleep 30' false 'sleep 30' |
+  "$IEXEC" --jobs=- --parallel=2 --fail-fast --job-log="$jobs_log"
+status=$?
+if [ "$status" -ne 1 ] || ! grep -q ' signal=TERM .* command=sleep 30$' "$jobs_log" ||
+    [ "$(wc -l <"$jobs_log")" -ne 2 ]; then
+  fail "fail-fast did not stop the batch: $status $(cat "$jobs_log")"
+fi
+printf '%s\n' 'sleep 30' 'sleep 30' |
+  "$IEXEC" --jobs=- --parallel=1 --job-log=/dev/null &
+pid=$!
+sleep 1
+kill -TERM "$pid"
+wait "$pid"
+status=$?
+if [ "$status" -ne 143 ]; then
+  fail "expected a stopped batch to exit with status 143, got $status"
+fi
+printf '%s\n' "sh -c '(sleep 1; echo orphan) & exit 0'" |
+  "$IEXEC" --jobs=- --job-log=/dev/null >"$tmpdir/jobs.out"
+if [ "$(cat "$tmpdir/jobs.out")" != orphan ]; then
+  fail "job runner exited before the orphan of a job"
+fi
+printf '%s\n' 'echo "unterminated' FOO=bar | "$IEXEC" --jobs=- \
+  --job-log="$jobs_log"
+status=$?
+if [ "$status" -ne 1 ] || ! grep -q '^job=1 error=syntax' "$jobs_log" ||
+    ! grep -q '^job=2 error=nocommand command=FOO=bar$' "$jobs_log"; then
+  fail "unexpected job errors: $status $(cat "$jobs_log")"
+fi
+run_expect_status 1 --jobs="$tmpdir/no-such-list" /bin/true 2>/dev/null
+run_expect_status 1 --parallel=0 --jobs=- /bin/true 2>/dev/null
+run_expect_status 1 --jobs=- --reload /bin/true </dev/null 2>/dev/null
+
+# timeouts and CPU budget exit with 124, normal exits keep their status
+run_expect_status 124 -q --timeout=0.5 /bin/sleep 30
+run_expect_status 3 --timeout=30 /bin/sh -c 'exit 3'
+run_expect_status 124 -q --timeout=0.5 /bin/sh -c \
+  'trap "exit 0" TERM; while :; do sleep 0.1; done'
+start=$(date +%s)
+run_expect_status 124 -q --timeout=0.5 --kill-after=0.5 --timeout-tree \
+  /bin/sh -c 'trap "" TERM; sleep 30; true'
+if [ $(($(date +%s) - start)) -ge 10 ]; then
+  fail "--kill-after did not kill the tree of an unresponsive child"
+fi
+run_expect_status 124 -q --cpu-limit=1 /bin/sh -c 'while :; do :; done'
+printf '%s\n' 'sleep 30' true | "$IEXEC" -q --jobs=- --parallel=2 \
+  --timeout=0.5 --job-log="$jobs_log"
+status=$?
+if [ "$status" -ne 124 ] ||
+    ! grep -q '^job=1 .* signal=TERM limit=timeout .* command=sleep 30$' "$jobs_log" ||
+    ! grep -q '^job=2 .* exit=0 wall' "$jobs_log"; then
+  fail "unexpected job timeout results: $status $(cat "$jobs_log")"
+fi
+run_expect_status 1 --timeout=1x /bin/true 2>/dev/null
+run_expect_status 1 --kill-after=-1 /bin/true 2>/dev/null
+run_expect_status 1 --timeout-signal=NONE /bin/true 2>/dev/null
@@ -0,0 +1,375 @@
+/*
+ * Replay randomized interleavings through the wait loop.
+ *
+ * Usage: iexec-sim [-v] [-n COUNT] [-s SEED]
+ *
+ * Scenario i is generated from seed SEED + i and run in-process through
+ * iexec_wait_for_children() or iexec_wait_forever(), linked against the fake
+ * kernel of iexec_sim_kernel.c, the reload handover of iexec_reload.c and the
+ * stubs below. The invariants are:
+ *
+ *   - iexec exits through iexec_exit_from_wait_status() with the wait status
+ *     of the main child, or of the candidate that replaced it, and only once
+ *     every child is reaped;
+ *   - a reload candidate is promoted only while unreaped;
+ *   - iexec_wait_forever() reaps every child and then sleeps;
+ *   - every child is reported exactly once, with its own status;
+ *   - a signal handled while the main child is unreaped is forwarded to it
+ *     or its group, rewritten as configured, and with its sigqueue payload
+ *     when forwarding to the child only;
+ *   - kill() never targets a reaped child, whose pid may have been reused,
+ *     nor a candidate that was never spawned;
+ *   - no fatal error, no lost wakeup and no livelock.
+ *
+ * The first failing scenario is replayed with its trace on stderr, and the
+ * exit status is 1. With -v every scenario is traced.
+ */
+#include "iexec_sim.h"
+#include "iexec_command.h"
+#include "iexec_control.h"
+#include "iexec_forward.h"
+#include "iexec_jobs.h"
+#include "iexec_journal.h"
+#include "iexec_print.h"
+#include "iexec_process.h"
+#include "iexec_proctree.h"
+#include "iexec_reload.h"
+#include "iexec_timeout.h"
+#include "iexec_wait.h"
+#include "iexec_watchdog.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define IEXEC_SIM_DEFAULT_COUNT 200000
+
+enum { IEXEC_SIM_RUNNING, IEXEC_SIM_PASSED, IEXEC_SIM_FAILED };
+
+static const int iexec_sim_external_signals[] = {
+    SIGTERM, SIGINT, SIGHUP, SIGQUIT, SIGUSR1, SIGUSR2, SIGWINCH, 0};
+static iexec_sim_scenario_t iexec_sim_scenario;
+static jmp_buf iexec_sim_jmp;
+static char iexec_sim_failure[256];
+static int iexec_sim_stragglers = 0;
+
+void iexec_sim_trace(const char *msg, ...) {
+  if (!iexec_sim_verbose) {
+    return;
+  }
+  va_list args;
+  va_start(args, msg);
+  fputs("  ", stderr);
+  vfprintf(stderr, msg, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+void iexec_sim_fail(const char *msg, ...) {
+  va_list args;
+  va_start(args, msg);
+  vsnprintf(iexec_sim_failure, sizeof(iexec_sim_failure), msg, args);
+  va_end(args);
+  longjmp(iexec_sim_jmp, IEXEC_SIM_FAILED);
+}
+
+static void iexec_sim_pass(void) __attribute__((noreturn));
+
+static void iexec_sim_pass(void) {
+  if (!iexec_sim_kernel_settled()) {
+    iexec_sim_fail("not every child was reaped and reported");
+  }
+  longjmp(iexec_sim_jmp, IEXEC_SIM_PASSED);
+}
+
+void iexec_sim_stalled(void) {
+  if (!iexec_sim_scenario.forever) {
+    iexec_sim_fail("waiting forever for children");
+  }
+  iexec_sim_pass();
+}
+
+/* stubs for the modules the wait loop calls into */
+
+void iexec_printf(iexec_print_level_t level, const char *msg, ...) {
+  if (!iexec_sim_verbose) {
+    return;
+  }
+  va_list args;
+  va_start(args, msg);
+  fprintf(stderr, "  iexec (level %d): ", (int)level);
+  vfprintf(stderr, msg, args);
+  va_end(args);
+}
+
+int iexec_errno(void) { return errno; }
+
+const char *iexec_strerror(int errnum) { return strerror(errnum); }
+
+void iexec_exit(int status) {
+  iexec_sim_fail("iexec_exit(%d)", status);
+}
+
+void iexec_exit_from_wait_status(int status) {
+  iexec_sim_trace("exit from wait status %#x", (unsigned)status);
+  if (iexec_sim_scenario.forever) {
+    iexec_sim_fail("iexec_wait_forever() exited");
+  }
+  int main_status =
+      iexec_sim_scenario.status[iexec_sim_kernel_main() - IEXEC_SIM_MAIN_PID];
+  if (status != main_status) {
+    iexec_sim_fail("exit from status %#x instead of the main child's %#x",
+                   (unsigned)status, (unsigned)main_status);
+  }
+  if (iexec_sim_stragglers != 1) {
+    iexec_sim_fail("stragglers reported %d times", iexec_sim_stragglers);
+  }
+  iexec_sim_pass();
+}
+
+void iexec_control_reaped(pid_t pid, int status) {
+  iexec_sim_kernel_reported(pid, status);
+}
+
+int iexec_journal_enabled(void) { return iexec_sim_scenario.journal; }
+
+void iexec_journal_stage_comm(pid_t pid) {
+  if (!iexec_sim_kernel_zombie(pid)) {
+    iexec_sim_fail("journal names %d, which is not a zombie", (int)pid);
+  }
+}
+
+void iexec_journal_record(iexec_journal_type_t type, pid_t pid, int arg0,
+                          int arg1) {
+  (void)arg0;
+  (void)arg1;
+  // the wait loop records a handover right after it switches to the new pid
+  if (type == IEXEC_JOURNAL_RELOAD) {
+    iexec_sim_kernel_promote(pid);
+  }
+}
+
+void iexec_proctree_reaped(pid_t pid) { (void)pid; }
+
+void iexec_proctree_report_stragglers(void) {
+  if (!iexec_sim_kernel_reaped(iexec_sim_kernel_main())) {
+    iexec_sim_fail("stragglers reported before main was reaped");
+  }
+  iexec_sim_stragglers++;
+}
+
+void iexec_command_catch_signal(int signum) { (void)signum; }
+
+/* only the reload handover spawns, handing over its readiness pipe */
+pid_t iexec_command_spawn(iexec_command_prepare_t prepare, void *arg) {
+  (void)prepare;
+  return iexec_sim_kernel_spawn(*(const int *)arg);
+}
+
+void iexec_watchdog_watch(pid_t pid) { (void)pid; }
+
+pid_t iexec_watchdog_restart(pid_t pid) {
+  (void)pid;
+  return -1;
+}
+
+void iexec_timeout_watch(pid_t pid) { (void)pid; }
+
+iexec_timeout_limit_t iexec_timeout_reaped(pid_t pid, int status,
+                                           const struct rusage *usage) {
+  (void)pid;
+  (void)status;
+  (void)usage;
+  return IEXEC_TIMEOUT_LIMIT_NONE;
+}
+
+/* the job runner has its own loop, which the scenarios do not run */
+
+void iexec_jobs_start(void) { iexec_sim_fail("job runner started"); }
+
+int iexec_jobs_reaped(pid_t pid, int status, const struct rusage *usage) {
+  (void)pid;
+  (void)status;
+  (void)usage;
+  return 0;
+}
+
+void iexec_jobs_take_signals(void) {}
+
+int iexec_jobs_finished(void) { return 1; }
+
+void iexec_jobs_exit(void) { iexec_sim_fail("job runner exited"); }
+
+static void iexec_sim_generate(uint64_t seed) {
+  iexec_sim_scenario_t *s = &iexec_sim_scenario;
+  memset(s, 0, sizeof(*s));
+  iexec_sim_srandom(seed);
+  s->seed = seed;
+  s->forever = iexec_sim_random(4) == 0;
+  s->journal = (int)iexec_sim_random(2);
+  s->children = 1 + (int)iexec_sim_random(IEXEC_SIM_MAX_CHILDREN);
+  for (int i = 0; i < s->children; i++) {
+    if (iexec_sim_random(4) == 0) {
+      s->status[i] = 1 + (int)iexec_sim_random(31);
+    } else {
+      s->status[i] = (int)iexec_sim_random(256) << 8;
+    }
+    s->event[s->events].type = IEXEC_SIM_EVENT_EXIT;
+    s->event[s->events].pid = IEXEC_SIM_MAIN_PID + i;
+    s->events++;
+  }
+
+  // a reload spawns one more child, which the scenario may never see
+  if (!s->forever && s->children < IEXEC_SIM_MAX_CHILDREN &&
+      iexec_sim_random(3) == 0) {
+    s->candidate = s->children;
+    s->status[s->candidate] = (int)iexec_sim_random(256) << 8;
+    s->children++;
+    s->option.reload_signal = SIGHUP;
+    s->option.reload_stop_signal = SIGTERM;
+    s->option.reload_timeout = (int)iexec_sim_random(2);
+    pid_t pid = IEXEC_SIM_MAIN_PID + s->candidate;
+    iexec_sim_event_type_t types[] = {
+        IEXEC_SIM_EVENT_EXIT, IEXEC_SIM_EVENT_READY, IEXEC_SIM_EVENT_TIMER};
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+      s->event[s->events].type = types[i];
+      s->event[s->events].pid = pid;
+      s->events++;
+    }
+    s->event[s->events].type = IEXEC_SIM_EVENT_SIGNAL;
+    s->event[s->events].signum = SIGHUP;
+    s->events++;
+  }
+  iexec_reload_configure(&s->option);
+
+  s->option.forward = (iexec_forward_mode_t)iexec_sim_random(3);
+  s->option.forward_all = (int)iexec_sim_random(2);
+  for (int signum = 0; signum < NSIG; signum++) {
+    s->option.signal_rewrite[signum] = signum;
+  }
+  switch (iexec_sim_random(6)) {
+  case 0:
+    s->option.signal_rewrite[SIGTERM] = SIGQUIT;
+    break;
+  case 1:
+    s->option.signal_rewrite[SIGINT] = 0;
+    break;
+  case 2:
+    s->option.signal_rewrite[SIGUSR1] = SIGTERM;
+    break;
+  default:
+    break;
+  }
+  iexec_forward_configure(&s->option);
+
+  // only signals with a forwarder: the others are not the wait loop's
+  int signals =
+      s->forever ? 0 : (int)iexec_sim_random(IEXEC_SIM_MAX_SIGNALS + 1);
+  for (int i = 0; i < signals; i++) {
+    int count = sizeof(iexec_sim_external_signals) /
+                sizeof(iexec_sim_external_signals[0]);
+    int signum = iexec_sim_external_signals[iexec_sim_random((unsigned)count)];
+    if (signum == 0) {
+      signum = SIGRTMIN + (int)iexec_sim_random(4);
+    }
+    if (sigismember(iexec_forward_signals(), signum) != 1) {
+      continue;
+    }
+    s->event[s->events].type = IEXEC_SIM_EVENT_SIGNAL;
+    s->event[s->events].signum = signum;
+    s->events++;
+  }
+  for (int i = s->events - 1; i > 0; i--) {
+    int j = (int)iexec_sim_random((unsigned)i + 1);
+    iexec_sim_event_t event = s->event[i];
+    s->event[i] = s->event[j];
+    s->event[j] = event;
+  }
+  s->fire_percent = iexec_sim_random(100);
+  s->eintr_percent = iexec_sim_random(4) == 0 ? iexec_sim_random(20) : 0;
+}
+
+static int iexec_sim_run(uint64_t seed) {
+  iexec_sim_generate(seed);
+  iexec_sim_kernel_reset(&iexec_sim_scenario);
+  iexec_sim_stragglers = 0;
+  // a reload signal may have arrived after the previous scenario's main exited
+  iexec_reload_take();
+  iexec_sim_failure[0] = '\0';
+  if (iexec_sim_verbose) {
+    fprintf(stderr,
+            "seed %" PRIu64 ": %s, %d children, journal %d, forward %d, "
+            "all %d, fire %u%%, eintr %u%%\n",
+            seed,
+            iexec_sim_scenario.forever ? "wait_forever" : "wait_for_children",
+            iexec_sim_scenario.children, iexec_sim_scenario.journal,
+            (int)iexec_sim_scenario.option.forward,
+            iexec_sim_scenario.option.forward_all,
+            iexec_sim_scenario.fire_percent, iexec_sim_scenario.eintr_percent);
+  }
+  switch (setjmp(iexec_sim_jmp)) {
+  case IEXEC_SIM_RUNNING:
+    if (iexec_sim_scenario.forever) {
+      iexec_wait_forever();
+    }
+    iexec_wait_for_children(IEXEC_SIM_MAIN_PID);
+  case IEXEC_SIM_PASSED:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned long count = IEXEC_SIM_DEFAULT_COUNT;
+  uint64_t seed = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:v")) != -1) {
+    switch (opt) {
+    case 'n':
+      count = strtoul(optarg, NULL, 10);
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 10);
+      break;
+    case 'v':
+      iexec_sim_verbose = 1;
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-v] [-n COUNT] [-s SEED]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (unsigned long i = 0; i < count; i++) {
+    if (iexec_sim_run(seed + i)) {
+      continue;
+    }
+    if (!iexec_sim_verbose) {
+      // the failed run leaves the modules mid-handover, so replay it afresh
+      char replay[32];
+      snprintf(replay, sizeof(replay), "%" PRIu64, seed + i);
+      execl("/proc/self/exe", argv[0], "-v", "-n", "1", "-s", replay,
+            (char *)NULL);
+    }
+    fprintf(stderr, "iexec-sim: seed %" PRIu64 ": %s\n", seed + i,
+            iexec_sim_failure);
+    return EXIT_FAILURE;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = (double)(end.tv_sec - start.tv_sec) +
+                   (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("iexec-sim: %lu scenarios from seed %" PRIu64
+         " passed in %.2fs (%.0f/s)\n",
+         count, seed, seconds, seconds > 0 ? (double)count / seconds : 0.0);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "iexec.h"
+#include "iexec_option.h"
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Deterministic simulator for the wait loop.
+ *
+ * iexec_sim_kernel.c replaces the system call seams of iexec_syscall.h with a
+ * fake kernel: a handful of children, a signal mask, pending signals and
+ * handlers, plus the pipes and timer of a reload handover. A scenario is a
+ * shuffled queue of child exits, external signals and handover steps; the fake
+ * kernel fires them at random system call boundaries, so every run of the
+ * same seed replays the same interleaving.
+ */
+
+#define IEXEC_SIM_MAIN_PID 100
+#define IEXEC_SIM_MAX_CHILDREN 6
+#define IEXEC_SIM_MAX_SIGNALS 4
+/* a handover adds its ready byte, its timer and the reload signal */
+#define IEXEC_SIM_MAX_EVENTS                                                   \
+  (IEXEC_SIM_MAX_CHILDREN + IEXEC_SIM_MAX_SIGNALS + 3)
+
+typedef enum iexec_sim_event_type {
+  IEXEC_SIM_EVENT_EXIT,   /* child pid exits with status */
+  IEXEC_SIM_EVENT_SIGNAL, /* iexec receives signum from outside */
+  IEXEC_SIM_EVENT_READY,  /* the reload candidate writes its ready byte */
+  IEXEC_SIM_EVENT_TIMER   /* the armed readiness timer expires */
+} iexec_sim_event_type_t;
+
+typedef struct iexec_sim_event {
+  iexec_sim_event_type_t type;
+  pid_t pid;
+  int signum;
+} iexec_sim_event_t;
+
+typedef struct iexec_sim_scenario {
+  uint64_t seed;
+  int forever;   /* run iexec_wait_forever instead of iexec_wait_for_children */
+  int journal;   /* take the waitid peek path of the journal */
+  int children;  /* pids IEXEC_SIM_MAIN_PID onwards, the first one is main */
+  int candidate; /* index of the child spawned by a reload, 0 for none */
+  int status[IEXEC_SIM_MAX_CHILDREN];
+  int events;
+  iexec_sim_event_t event[IEXEC_SIM_MAX_EVENTS];
+  iexec_option_t option;  /* forwarding mode, signal set and rewrites */
+  unsigned fire_percent;  /* chance of an event at each system call */
+  unsigned eintr_percent; /* chance of a spurious EINTR from wait4 */
+} iexec_sim_scenario_t;
+
+/**
+ * @brief Print the trace of the scenario being replayed
+ */
+extern int iexec_sim_verbose;
+
+/**
+ * @brief Seed the pseudo-random generator
+ *
+ * @param seed seed
+ */
+void iexec_sim_srandom(uint64_t seed);
+
+/**
+ * @brief Next pseudo-random number
+ *
+ * @param bound exclusive upper bound, greater than zero
+ * @return number in [0, bound)
+ */
+unsigned iexec_sim_random(unsigned bound);
+
+/**
+ * @brief Reset the fake kernel to the initial state of a scenario
+ *
+ * @param scenario scenario, which must outlive the run
+ */
+void iexec_sim_kernel_reset(const iexec_sim_scenario_t *scenario);
+
+/**
+ * @brief Check that a child was reaped and is reported exactly once
+ *
+ * @param pid reported child
+ * @param status reported wait status
+ */
+void iexec_sim_kernel_reported(pid_t pid, int status);
+
+/**
+ * @brief Check whether a child has been reaped
+ *
+ * @param pid child
+ * @return 1 if reaped
+ */
+int iexec_sim_kernel_reaped(pid_t pid);
+
+/**
+ * @brief Check whether a child is a zombie
+ *
+ * @param pid child
+ * @return 1 if exited but not yet reaped
+ */
+int iexec_sim_kernel_zombie(pid_t pid);
+
+/**
+ * @brief Start the reload candidate
+ *
+ * @param fd write end of the readiness pipe, which the candidate inherits
+ * @return candidate pid, or -1 when the scenario has no candidate left
+ */
+pid_t iexec_sim_kernel_spawn(int fd);
+
+/**
+ * @brief Make a reload candidate the main child
+ *
+ * @param pid candidate, which must not have been reaped
+ */
+void iexec_sim_kernel_promote(pid_t pid);
+
+/**
+ * @brief Current main child
+ *
+ * @return pid of the main child, or of the candidate it was replaced by
+ */
+pid_t iexec_sim_kernel_main(void);
+
+/**
+ * @brief Check whether every child has been reaped and reported
+ *
+ * @return 1 if so
+ */
+int iexec_sim_kernel_settled(void);
+
+/**
+ * @brief Trace a step of the scenario, if verbose
+ *
+ * @param msg message
+ * @param ... arguments
+ */
+void iexec_sim_trace(const char *msg, ...)
+    __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief End the scenario with an invariant violation
+ *
+ * @param msg message
+ * @param ... arguments
+ */
+void iexec_sim_fail(const char *msg, ...)
+    __attribute__((format(printf, 1, 2), noreturn));
+
+/**
+ * @brief Called when iexec sleeps and nothing is left to wake it up
+ */
+void iexec_sim_stalled(void) __attribute__((noreturn));
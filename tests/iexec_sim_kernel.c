@@ -0,0 +1,738 @@
+/*
+ * Fake kernel behind the iexec_syscall.h seams.
+ *
+ * Signals are delivered the way the kernel does it, but only at system call
+ * boundaries: on entry to and return from every seam, and inside ppoll under
+ * its temporary mask. Handlers run synchronously with the signal and their
+ * sa_mask added to the mask. Pending signals coalesce, ignored signals are
+ * discarded unless blocked, and a signal whose default action terminates the
+ * process fails the scenario. Real-time signals arrive from sigqueue with a
+ * payload. The main child leads its own process group.
+ *
+ * Descriptors are limited to what the reload handover needs: pipes whose write
+ * end is inherited by the candidate, and a timer that expires when the
+ * scenario says so. A pipe is at end of file once iexec closed its write end
+ * and the candidate exited.
+ */
+#include "iexec_sim.h"
+#include "iexec_syscall.h"
+#include "iexec_wait.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+
+#define IEXEC_SIM_MAX_STEPS 10000
+#define IEXEC_SIM_SIGNALS NSIG
+#define IEXEC_SIM_FD_BASE 100
+#define IEXEC_SIM_MAX_FDS 8
+
+typedef enum iexec_sim_state {
+  IEXEC_SIM_UNBORN,
+  IEXEC_SIM_ALIVE,
+  IEXEC_SIM_ZOMBIE,
+  IEXEC_SIM_REAPED
+} iexec_sim_state_t;
+
+typedef enum iexec_sim_fd_type {
+  IEXEC_SIM_FD_CLOSED,
+  IEXEC_SIM_FD_PIPE_READ,
+  IEXEC_SIM_FD_PIPE_WRITE,
+  IEXEC_SIM_FD_TIMER
+} iexec_sim_fd_type_t;
+
+typedef struct iexec_sim_fd {
+  iexec_sim_fd_type_t type;
+  int peer;     /* other end of a pipe, -1 once closed */
+  pid_t holder; /* child that inherited the write end of a pipe, 0 for none */
+  int bytes;    /* unread bytes of a pipe, on its read end */
+  int armed;    /* timer set and not yet expired */
+  int expired;  /* timer expired and not yet read */
+} iexec_sim_fd_t;
+
+typedef struct iexec_sim_child {
+  iexec_sim_state_t state;
+  int status;
+  int reported;
+} iexec_sim_child_t;
+
+typedef uint64_t iexec_sim_sigset_t;
+
+static const iexec_sim_scenario_t *iexec_sim_scenario = NULL;
+static iexec_sim_child_t iexec_sim_children[IEXEC_SIM_MAX_CHILDREN];
+static int iexec_sim_main = 0;
+static iexec_sim_fd_t iexec_sim_fds[IEXEC_SIM_MAX_FDS];
+static int iexec_sim_fired[IEXEC_SIM_MAX_EVENTS];
+static unsigned long iexec_sim_steps = 0;
+static iexec_sim_sigset_t iexec_sim_mask = 0;
+static iexec_sim_sigset_t iexec_sim_pending = 0;
+static struct sigaction iexec_sim_actions[IEXEC_SIM_SIGNALS];
+static unsigned long iexec_sim_forwards[IEXEC_SIM_SIGNALS];
+static unsigned long iexec_sim_queued = 0;
+static int iexec_sim_payload = 0;
+static uint64_t iexec_sim_state = 1;
+
+int iexec_sim_verbose = 0;
+
+void iexec_sim_srandom(uint64_t seed) {
+  // splitmix64 of the seed, so that neighbouring seeds diverge at once
+  seed += 0x9e3779b97f4a7c15ULL;
+  seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebULL;
+  iexec_sim_state = (seed ^ (seed >> 31)) | 1;
+}
+
+unsigned iexec_sim_random(unsigned bound) {
+  // xorshift64*
+  iexec_sim_state ^= iexec_sim_state >> 12;
+  iexec_sim_state ^= iexec_sim_state << 25;
+  iexec_sim_state ^= iexec_sim_state >> 27;
+  return (unsigned)((iexec_sim_state * 0x2545f4914f6cdd1dULL) >> 32) % bound;
+}
+
+static iexec_sim_sigset_t iexec_sim_bit(int signum) {
+  return (iexec_sim_sigset_t)1 << (signum - 1);
+}
+
+static iexec_sim_sigset_t iexec_sim_from_sigset(const sigset_t *set) {
+  iexec_sim_sigset_t bits = 0;
+  for (int signum = 1; signum < IEXEC_SIM_SIGNALS; signum++) {
+    if (sigismember(set, signum) == 1) {
+      bits |= iexec_sim_bit(signum);
+    }
+  }
+  // SIGKILL and SIGSTOP cannot be blocked
+  return bits & ~(iexec_sim_bit(SIGKILL) | iexec_sim_bit(SIGSTOP));
+}
+
+static void iexec_sim_to_sigset(iexec_sim_sigset_t bits, sigset_t *set) {
+  sigemptyset(set);
+  for (int signum = 1; signum < IEXEC_SIM_SIGNALS; signum++) {
+    if (bits & iexec_sim_bit(signum)) {
+      sigaddset(set, signum);
+    }
+  }
+}
+
+static iexec_sim_child_t *iexec_sim_child(pid_t pid) {
+  int index = pid - IEXEC_SIM_MAIN_PID;
+  if (index < 0 || index >= iexec_sim_scenario->children) {
+    return NULL;
+  }
+  return &iexec_sim_children[index];
+}
+
+static int iexec_sim_main_unreaped(void) {
+  return !iexec_sim_scenario->forever &&
+         iexec_sim_children[iexec_sim_main].state != IEXEC_SIM_REAPED;
+}
+
+static int iexec_sim_instance(pid_t pid) {
+  int index = pid - IEXEC_SIM_MAIN_PID;
+  return index == 0 ||
+         (iexec_sim_scenario->candidate != 0 &&
+          index == iexec_sim_scenario->candidate);
+}
+
+static iexec_sim_fd_t *iexec_sim_fd(const char *call, int fd) {
+  int index = fd - IEXEC_SIM_FD_BASE;
+  if (index < 0 || index >= IEXEC_SIM_MAX_FDS ||
+      iexec_sim_fds[index].type == IEXEC_SIM_FD_CLOSED) {
+    iexec_sim_fail("%s(%d) on a descriptor that is not open", call, fd);
+  }
+  return &iexec_sim_fds[index];
+}
+
+static int iexec_sim_fd_open(iexec_sim_fd_type_t type) {
+  for (int i = 0; i < IEXEC_SIM_MAX_FDS; i++) {
+    if (iexec_sim_fds[i].type == IEXEC_SIM_FD_CLOSED) {
+      memset(&iexec_sim_fds[i], 0, sizeof(iexec_sim_fds[i]));
+      iexec_sim_fds[i].type = type;
+      iexec_sim_fds[i].peer = -1;
+      return IEXEC_SIM_FD_BASE + i;
+    }
+  }
+  iexec_sim_fail("descriptors leak, %d are open", IEXEC_SIM_MAX_FDS);
+}
+
+static int iexec_sim_readable(const iexec_sim_fd_t *file) {
+  if (file->type == IEXEC_SIM_FD_TIMER) {
+    return file->expired;
+  }
+  if (file->type != IEXEC_SIM_FD_PIPE_READ) {
+    return 0;
+  }
+  if (file->bytes > 0) {
+    return 1;
+  }
+  if (file->peer != -1) {
+    return 0;
+  }
+  iexec_sim_child_t *holder = iexec_sim_child(file->holder);
+  return holder == NULL || holder->state != IEXEC_SIM_ALIVE;
+}
+
+static iexec_sim_fd_t *iexec_sim_timer(void) {
+  for (int i = 0; i < IEXEC_SIM_MAX_FDS; i++) {
+    if (iexec_sim_fds[i].type == IEXEC_SIM_FD_TIMER) {
+      return &iexec_sim_fds[i];
+    }
+  }
+  return NULL;
+}
+
+static iexec_sim_fd_t *iexec_sim_ready_pipe(pid_t pid) {
+  for (int i = 0; i < IEXEC_SIM_MAX_FDS; i++) {
+    if (iexec_sim_fds[i].type == IEXEC_SIM_FD_PIPE_READ &&
+        iexec_sim_fds[i].holder == pid) {
+      return &iexec_sim_fds[i];
+    }
+  }
+  return NULL;
+}
+
+static int iexec_sim_ignored(int signum) {
+  return iexec_sim_actions[signum].sa_handler == SIG_IGN ||
+         (iexec_sim_actions[signum].sa_handler == SIG_DFL &&
+          (signum == SIGCHLD || signum == SIGURG || signum == SIGWINCH));
+}
+
+static void iexec_sim_raise(int signum) {
+  if (iexec_sim_ignored(signum) && !(iexec_sim_mask & iexec_sim_bit(signum))) {
+    return;
+  }
+  iexec_sim_pending |= iexec_sim_bit(signum);
+}
+
+static int iexec_sim_fireable(const iexec_sim_event_t *event) {
+  iexec_sim_fd_t *timer;
+  switch (event->type) {
+  case IEXEC_SIM_EVENT_SIGNAL:
+    // signals sent before iexec can handle them are not the wait loop's
+    // business, so they wait until the forwarders are installed
+    return iexec_sim_actions[event->signum].sa_handler != SIG_DFL;
+  case IEXEC_SIM_EVENT_TIMER:
+    timer = iexec_sim_timer();
+    return timer != NULL && timer->armed;
+  default:
+    // the candidate neither exits nor gets ready before it is spawned
+    return iexec_sim_child(event->pid)->state == IEXEC_SIM_ALIVE;
+  }
+}
+
+static int iexec_sim_fire(void) {
+  // the first event that can happen does, so a candidate that is never
+  // spawned does not hold back the rest of the scenario
+  int i = 0;
+  while (i < iexec_sim_scenario->events &&
+         (iexec_sim_fired[i] ||
+          !iexec_sim_fireable(&iexec_sim_scenario->event[i]))) {
+    i++;
+  }
+  if (i == iexec_sim_scenario->events) {
+    return 0;
+  }
+  const iexec_sim_event_t *event = &iexec_sim_scenario->event[i];
+  iexec_sim_child_t *child;
+  iexec_sim_fd_t *file;
+  switch (event->type) {
+  case IEXEC_SIM_EVENT_SIGNAL:
+    iexec_sim_trace("signal %d arrives", event->signum);
+    iexec_sim_raise(event->signum);
+    break;
+  case IEXEC_SIM_EVENT_READY:
+    file = iexec_sim_ready_pipe(event->pid);
+    iexec_sim_trace("child %d writes its ready byte%s", (int)event->pid,
+                    file == NULL ? " to a closed pipe" : "");
+    if (file != NULL) {
+      file->bytes++;
+    }
+    break;
+  case IEXEC_SIM_EVENT_TIMER:
+    file = iexec_sim_timer();
+    file->armed = 0;
+    file->expired = 1;
+    iexec_sim_trace("readiness timer expires");
+    break;
+  default:
+    child = iexec_sim_child(event->pid);
+    child->state = IEXEC_SIM_ZOMBIE;
+    iexec_sim_trace("child %d exits with status %#x", (int)event->pid,
+                    (unsigned)child->status);
+    iexec_sim_raise(SIGCHLD);
+    break;
+  }
+  iexec_sim_fired[i] = 1;
+  return 1;
+}
+
+static unsigned long iexec_sim_forward_total(void) {
+  unsigned long total = 0;
+  for (int signum = 1; signum < IEXEC_SIM_SIGNALS; signum++) {
+    total += iexec_sim_forwards[signum];
+  }
+  return total;
+}
+
+static int iexec_sim_deliver(void) {
+  int delivered = 0;
+  iexec_sim_sigset_t ready;
+  while ((ready = iexec_sim_pending & ~iexec_sim_mask) != 0) {
+    int signum = __builtin_ctzll(ready) + 1;
+    const struct sigaction *action = &iexec_sim_actions[signum];
+    iexec_sim_pending &= ~iexec_sim_bit(signum);
+    if (iexec_sim_ignored(signum)) {
+      continue;
+    }
+    if (action->sa_handler == SIG_DFL) {
+      iexec_sim_fail("signal %d terminates iexec", signum);
+    }
+
+    // the reload signal is handled by iexec itself, never forwarded
+    int external = signum != SIGCHLD &&
+                   signum != iexec_sim_scenario->option.reload_signal;
+    int forward = external && iexec_sim_main_unreaped();
+    int signum_out = iexec_sim_scenario->option.signal_rewrite[signum];
+    int queued = signum >= SIGRTMIN;
+    unsigned long forwards = iexec_sim_forward_total();
+    unsigned long forwards_out = iexec_sim_forwards[signum_out];
+    unsigned long queued_saved = iexec_sim_queued;
+    int payload_saved = iexec_sim_payload;
+    iexec_sim_sigset_t mask_saved = iexec_sim_mask;
+    iexec_sim_mask |= iexec_sim_from_sigset(&action->sa_mask);
+    if (!(action->sa_flags & SA_NODEFER)) {
+      iexec_sim_mask |= iexec_sim_bit(signum);
+    }
+    iexec_sim_trace("handler %d runs", signum);
+    if (action->sa_flags & SA_SIGINFO) {
+      siginfo_t info;
+      memset(&info, 0, sizeof(info));
+      info.si_signo = signum;
+      info.si_code = queued ? SI_QUEUE : SI_USER;
+      info.si_value.sival_int = (int)iexec_sim_steps;
+      iexec_sim_payload = info.si_value.sival_int;
+      action->sa_sigaction(signum, &info, NULL);
+      iexec_sim_payload = payload_saved;
+    } else {
+      action->sa_handler(signum);
+    }
+    iexec_sim_mask = mask_saved;
+    delivered++;
+
+    if (signum_out == 0 && iexec_sim_forward_total() != forwards) {
+      iexec_sim_fail("signal %d forwarded although rewritten to NONE", signum);
+    }
+    if (forward && signum_out != 0 &&
+        iexec_sim_forwards[signum_out] == forwards_out) {
+      iexec_sim_fail("signal %d handled before main was reaped, not forwarded "
+                     "as %d",
+                     signum, signum_out);
+    }
+    if (forward && signum_out != 0 && queued &&
+        iexec_sim_queued == queued_saved &&
+        iexec_sim_scenario->option.forward == IEXEC_FORWARD_MODE_CHILD) {
+      iexec_sim_fail("payload of signal %d not forwarded", signum);
+    }
+  }
+  return delivered;
+}
+
+static void iexec_sim_boundary(void) {
+  if (++iexec_sim_steps > IEXEC_SIM_MAX_STEPS) {
+    iexec_sim_fail("no exit after %d system calls", IEXEC_SIM_MAX_STEPS);
+  }
+  if (iexec_sim_random(100) < iexec_sim_scenario->fire_percent) {
+    iexec_sim_fire();
+  }
+  iexec_sim_deliver();
+}
+
+void iexec_sim_kernel_reset(const iexec_sim_scenario_t *scenario) {
+  iexec_sim_scenario = scenario;
+  iexec_sim_main = 0;
+  memset(iexec_sim_fired, 0, sizeof(iexec_sim_fired));
+  iexec_sim_steps = 0;
+  iexec_sim_mask = 0;
+  iexec_sim_pending = 0;
+  memset(iexec_sim_actions, 0, sizeof(iexec_sim_actions));
+  memset(iexec_sim_forwards, 0, sizeof(iexec_sim_forwards));
+  iexec_sim_queued = 0;
+  iexec_sim_payload = 0;
+  for (int i = 0; i < IEXEC_SIM_SIGNALS; i++) {
+    iexec_sim_actions[i].sa_handler = SIG_DFL;
+  }
+  for (int i = 0; i < scenario->children; i++) {
+    iexec_sim_children[i].state = scenario->candidate != 0 &&
+                                          i == scenario->candidate
+                                      ? IEXEC_SIM_UNBORN
+                                      : IEXEC_SIM_ALIVE;
+    iexec_sim_children[i].status = scenario->status[i];
+    iexec_sim_children[i].reported = 0;
+  }
+  // the previous scenario ended with a longjmp, leaving its descriptors
+  // registered with the wait loop
+  for (int i = 0; i < IEXEC_SIM_MAX_FDS; i++) {
+    if (iexec_sim_fds[i].type != IEXEC_SIM_FD_CLOSED) {
+      iexec_wait_remove_fd(IEXEC_SIM_FD_BASE + i);
+      iexec_sim_fds[i].type = IEXEC_SIM_FD_CLOSED;
+    }
+  }
+}
+
+void iexec_sim_kernel_reported(pid_t pid, int status) {
+  iexec_sim_child_t *child = iexec_sim_child(pid);
+  if (child == NULL || child->state != IEXEC_SIM_REAPED) {
+    iexec_sim_fail("child %d reported but not reaped", (int)pid);
+  }
+  if (child->reported) {
+    iexec_sim_fail("child %d reported twice", (int)pid);
+  }
+  if (child->status != status) {
+    iexec_sim_fail("child %d reported with status %#x instead of %#x",
+                   (int)pid, (unsigned)status, (unsigned)child->status);
+  }
+  child->reported = 1;
+}
+
+int iexec_sim_kernel_reaped(pid_t pid) {
+  iexec_sim_child_t *child = iexec_sim_child(pid);
+  return child != NULL && child->state == IEXEC_SIM_REAPED;
+}
+
+int iexec_sim_kernel_zombie(pid_t pid) {
+  iexec_sim_child_t *child = iexec_sim_child(pid);
+  return child != NULL && child->state == IEXEC_SIM_ZOMBIE;
+}
+
+pid_t iexec_sim_kernel_spawn(int fd) {
+  int index = iexec_sim_scenario->candidate;
+  iexec_sim_fd_t *file = iexec_sim_fd("spawn", fd);
+  if (index == 0 || iexec_sim_children[index].state != IEXEC_SIM_UNBORN) {
+    iexec_sim_trace("spawn fails");
+    errno = EAGAIN;
+    return -1;
+  }
+  if (file->type != IEXEC_SIM_FD_PIPE_WRITE) {
+    iexec_sim_fail("spawn hands over %d, which is not a pipe", fd);
+  }
+  iexec_sim_children[index].state = IEXEC_SIM_ALIVE;
+  iexec_sim_fds[file->peer].holder = IEXEC_SIM_MAIN_PID + index;
+  iexec_sim_trace("child %d spawned", IEXEC_SIM_MAIN_PID + index);
+  return IEXEC_SIM_MAIN_PID + index;
+}
+
+void iexec_sim_kernel_promote(pid_t pid) {
+  iexec_sim_child_t *child = iexec_sim_child(pid);
+  if (child == NULL ||
+      pid - IEXEC_SIM_MAIN_PID != iexec_sim_scenario->candidate) {
+    iexec_sim_fail("%d promoted, which is not the candidate", (int)pid);
+  }
+  if (child->state == IEXEC_SIM_UNBORN || child->state == IEXEC_SIM_REAPED) {
+    iexec_sim_fail("%d promoted after it was reaped", (int)pid);
+  }
+  iexec_sim_trace("child %d promoted", (int)pid);
+  iexec_sim_main = pid - IEXEC_SIM_MAIN_PID;
+}
+
+pid_t iexec_sim_kernel_main(void) {
+  return IEXEC_SIM_MAIN_PID + iexec_sim_main;
+}
+
+int iexec_sim_kernel_settled(void) {
+  for (int i = 0; i < iexec_sim_scenario->children; i++) {
+    if (iexec_sim_children[i].state == IEXEC_SIM_UNBORN) {
+      continue;
+    }
+    if (iexec_sim_children[i].state != IEXEC_SIM_REAPED ||
+        !iexec_sim_children[i].reported) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static pid_t iexec_sim_find(pid_t pid, int reap, int *status) {
+  int zombies[IEXEC_SIM_MAX_CHILDREN];
+  int count = 0;
+  int alive = 0;
+  for (int i = 0; i < iexec_sim_scenario->children; i++) {
+    if (pid != -1 && pid != IEXEC_SIM_MAIN_PID + i) {
+      continue;
+    }
+    if (iexec_sim_children[i].state == IEXEC_SIM_ZOMBIE) {
+      zombies[count++] = i;
+    } else if (iexec_sim_children[i].state == IEXEC_SIM_ALIVE) {
+      alive = 1;
+    }
+  }
+  if (count == 0) {
+    if (alive) {
+      return 0;
+    }
+    errno = ECHILD;
+    return -1;
+  }
+  // the kernel does not promise any order among zombies
+  int index = zombies[iexec_sim_random((unsigned)count)];
+  if (reap) {
+    iexec_sim_children[index].state = IEXEC_SIM_REAPED;
+    *status = iexec_sim_children[index].status;
+    iexec_sim_trace("child %d reaped", IEXEC_SIM_MAIN_PID + index);
+  }
+  return IEXEC_SIM_MAIN_PID + index;
+}
+
+pid_t iexec_wait4(pid_t pid, int *status, int options, struct rusage *usage) {
+  iexec_sim_boundary();
+  if (options != WNOHANG) {
+    iexec_sim_fail("wait4 with options %#x", (unsigned)options);
+  }
+  if (usage != NULL) {
+    memset(usage, 0, sizeof(*usage));
+  }
+  pid_t ret;
+  if (iexec_sim_random(100) < iexec_sim_scenario->eintr_percent) {
+    errno = EINTR;
+    ret = -1;
+  } else {
+    ret = iexec_sim_find(pid, 1, status);
+  }
+  iexec_sim_boundary();
+  return ret;
+}
+
+int iexec_waitid(idtype_t idtype, id_t id, siginfo_t *info, int options) {
+  (void)id;
+  iexec_sim_boundary();
+  if (idtype != P_ALL || options != (WEXITED | WNOWAIT | WNOHANG)) {
+    iexec_sim_fail("waitid with options %#x", (unsigned)options);
+  }
+  int ret = 0;
+  pid_t pid = iexec_sim_find(-1, 0, NULL);
+  if (pid == -1) {
+    ret = -1;
+  } else {
+    info->si_pid = pid;
+  }
+  iexec_sim_boundary();
+  return ret;
+}
+
+static int iexec_sim_poll_ready(struct pollfd *fds, nfds_t nfds) {
+  int ready = 0;
+  for (nfds_t i = 0; i < nfds; i++) {
+    fds[i].revents = 0;
+    if (iexec_sim_readable(iexec_sim_fd("ppoll", fds[i].fd))) {
+      fds[i].revents = POLLIN;
+      ready++;
+    }
+  }
+  return ready;
+}
+
+int iexec_ppoll(struct pollfd *fds, nfds_t nfds, const struct timespec *timeout,
+                const sigset_t *sigmask) {
+  iexec_sim_boundary();
+  if (timeout != NULL || sigmask == NULL) {
+    iexec_sim_fail("ppoll with a timeout");
+  }
+  iexec_sim_sigset_t mask_saved = iexec_sim_mask;
+  iexec_sim_mask = iexec_sim_from_sigset(sigmask);
+  int ret = -1;
+  while (1) {
+    // a readable descriptor and a deliverable signal race
+    int ready = iexec_sim_poll_ready(fds, nfds);
+    if (ready > 0 && ((iexec_sim_pending & ~iexec_sim_mask) == 0 ||
+                      iexec_sim_random(2) == 0)) {
+      ret = ready;
+      break;
+    }
+    if (iexec_sim_deliver() > 0) {
+      errno = EINTR;
+      break;
+    }
+    // nothing deliverable: sleep until the next event
+    if (ready == 0 && !iexec_sim_fire()) {
+      iexec_sim_mask = mask_saved;
+      iexec_sim_trace("ppoll sleeps forever");
+      iexec_sim_stalled();
+    }
+  }
+  iexec_sim_mask = mask_saved;
+  iexec_sim_boundary();
+  return ret;
+}
+
+int iexec_sigaction(int signum, const struct sigaction *action,
+                    struct sigaction *old) {
+  iexec_sim_boundary();
+  if (signum <= 0 || signum >= IEXEC_SIM_SIGNALS || signum == SIGKILL ||
+      signum == SIGSTOP) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (old != NULL) {
+    *old = iexec_sim_actions[signum];
+  }
+  if (action != NULL) {
+    iexec_sim_actions[signum] = *action;
+    if (iexec_sim_ignored(signum)) {
+      iexec_sim_pending &= ~iexec_sim_bit(signum);
+    }
+  }
+  iexec_sim_boundary();
+  return 0;
+}
+
+int iexec_sigprocmask(int how, const sigset_t *set, sigset_t *old) {
+  iexec_sim_boundary();
+  if (old != NULL) {
+    iexec_sim_to_sigset(iexec_sim_mask, old);
+  }
+  if (set != NULL) {
+    iexec_sim_sigset_t bits = iexec_sim_from_sigset(set);
+    if (how == SIG_BLOCK) {
+      iexec_sim_mask |= bits;
+    } else if (how == SIG_UNBLOCK) {
+      iexec_sim_mask &= ~bits;
+    } else if (how == SIG_SETMASK) {
+      iexec_sim_mask = bits;
+    } else {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+  iexec_sim_boundary();
+  return 0;
+}
+
+static int iexec_sim_signal_child(const char *call, pid_t pid, int signum) {
+  iexec_sim_child_t *child = iexec_sim_child(pid < 0 ? -pid : pid);
+  // a group outlives its leader, so it may still be signalled after the
+  // leader is reaped; the simulated group has no other members, and its pid
+  // must never be signalled on its own again, since it may have been reused
+  if (child != NULL && child->state == IEXEC_SIM_REAPED && pid < 0 &&
+      strcmp(call, "kill") == 0) {
+    iexec_sim_trace("%s(%d, %d) = ESRCH", call, (int)pid, signum);
+    errno = ESRCH;
+    return -1;
+  }
+  if (child == NULL || child->state == IEXEC_SIM_REAPED) {
+    iexec_sim_fail("%s(%d, %d) targets a process that is not a child", call,
+                   (int)pid, signum);
+  }
+  if (child->state == IEXEC_SIM_UNBORN) {
+    iexec_sim_fail("%s(%d, %d) targets a child that was never spawned", call,
+                   (int)pid, signum);
+  }
+  if (pid < 0 && (!iexec_sim_instance(-pid) ||
+                  iexec_sim_scenario->option.forward ==
+                      IEXEC_FORWARD_MODE_CHILD)) {
+    iexec_sim_fail("%s(%d, %d) targets a group", call, (int)pid, signum);
+  }
+  iexec_sim_trace("%s(%d, %d)", call, (int)pid, signum);
+  if ((pid == iexec_sim_kernel_main() || pid == -iexec_sim_kernel_main()) &&
+      signum > 0 && signum < IEXEC_SIM_SIGNALS) {
+    iexec_sim_forwards[signum]++;
+  }
+  return 0;
+}
+
+int iexec_kill(pid_t pid, int signum) {
+  iexec_sim_boundary();
+  int ret = iexec_sim_signal_child("kill", pid, signum);
+  iexec_sim_boundary();
+  return ret;
+}
+
+int iexec_sigqueue(pid_t pid, int signum, union sigval value) {
+  iexec_sim_boundary();
+  iexec_sim_signal_child("sigqueue", pid, signum);
+  if (value.sival_int != iexec_sim_payload) {
+    iexec_sim_fail("sigqueue payload %d instead of %d", value.sival_int,
+                   iexec_sim_payload);
+  }
+  iexec_sim_queued++;
+  iexec_sim_boundary();
+  return 0;
+}
+
+int iexec_pipe2(int fds[2], int flags) {
+  (void)flags;
+  iexec_sim_boundary();
+  fds[0] = iexec_sim_fd_open(IEXEC_SIM_FD_PIPE_READ);
+  fds[1] = iexec_sim_fd_open(IEXEC_SIM_FD_PIPE_WRITE);
+  iexec_sim_fds[fds[0] - IEXEC_SIM_FD_BASE].peer = fds[1] - IEXEC_SIM_FD_BASE;
+  iexec_sim_fds[fds[1] - IEXEC_SIM_FD_BASE].peer = fds[0] - IEXEC_SIM_FD_BASE;
+  iexec_sim_trace("pipe2() = [%d, %d]", fds[0], fds[1]);
+  iexec_sim_boundary();
+  return 0;
+}
+
+ssize_t iexec_read(int fd, void *buf, size_t count) {
+  iexec_sim_boundary();
+  iexec_sim_fd_t *file = iexec_sim_fd("read", fd);
+  ssize_t ret = -1;
+  errno = EAGAIN;
+  if (file->type == IEXEC_SIM_FD_TIMER && file->expired) {
+    uint64_t expirations = 1;
+    if (count < sizeof(expirations)) {
+      iexec_sim_fail("read(%d) of a timer into %zu bytes", fd, count);
+    }
+    memcpy(buf, &expirations, sizeof(expirations));
+    file->expired = 0;
+    ret = (ssize_t)sizeof(expirations);
+  } else if (file->type == IEXEC_SIM_FD_PIPE_READ && file->bytes > 0) {
+    *(char *)buf = 'x';
+    file->bytes--;
+    ret = 1;
+  } else if (file->type == IEXEC_SIM_FD_PIPE_READ && iexec_sim_readable(file)) {
+    ret = 0;
+  } else if (file->type == IEXEC_SIM_FD_PIPE_WRITE) {
+    errno = EBADF;
+  }
+  iexec_sim_trace("read(%d) = %zd", fd, ret);
+  iexec_sim_boundary();
+  return ret;
+}
+
+int iexec_close(int fd) {
+  iexec_sim_boundary();
+  iexec_sim_fd_t *file = iexec_sim_fd("close", fd);
+  if (file->peer != -1) {
+    iexec_sim_fds[file->peer].peer = -1;
+  }
+  file->type = IEXEC_SIM_FD_CLOSED;
+  iexec_sim_trace("close(%d)", fd);
+  iexec_sim_boundary();
+  return 0;
+}
+
+int iexec_timerfd_create(int clockid, int flags) {
+  (void)clockid;
+  (void)flags;
+  iexec_sim_boundary();
+  if (iexec_sim_timer() != NULL) {
+    iexec_sim_fail("second timer created");
+  }
+  int fd = iexec_sim_fd_open(IEXEC_SIM_FD_TIMER);
+  iexec_sim_boundary();
+  return fd;
+}
+
+int iexec_timerfd_settime(int fd, int flags, const struct itimerspec *value,
+                          struct itimerspec *old) {
+  (void)flags;
+  iexec_sim_boundary();
+  iexec_sim_fd_t *file = iexec_sim_fd("timerfd_settime", fd);
+  if (file->type != IEXEC_SIM_FD_TIMER || old != NULL) {
+    iexec_sim_fail("timerfd_settime(%d) on a descriptor that is not a timer",
+                   fd);
+  }
+  // the scenario decides when the timer expires, so only arming matters
+  file->armed = value->it_value.tv_sec != 0 || value->it_value.tv_nsec != 0;
+  file->expired = 0;
+  iexec_sim_trace("readiness timer %s", file->armed ? "armed" : "disarmed");
+  iexec_sim_boundary();
+  return 0;
+}
@@ -0,0 +1,228 @@
+/*
+ * Count the system calls iexec makes per lifecycle phase.
+ *
+ * Usage: iexec-syscount [-v] IEXEC [ARG]...
+ *
+ * The traced iexec process is in the "startup" phase until its first fork and
+ * in the "wait" phase afterwards. Children forked by iexec are in the "spawn"
+ * phase until they exec the command, at which point they are detached, so the
+ * command's own system calls are never counted. The counts are printed as
+ * "PHASE COUNT" lines; with -v, a "PHASE NR COUNT" breakdown by system call
+ * number goes to stderr. The exit status is that of iexec, or 77 when ptrace
+ * is not available.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define IEXEC_SYSCOUNT_SKIP 77
+#define IEXEC_SYSCOUNT_MAX_PROCS 64
+#define IEXEC_SYSCOUNT_MAX_NR 1024
+
+typedef enum iexec_syscount_phase {
+  IEXEC_SYSCOUNT_STARTUP,
+  IEXEC_SYSCOUNT_SPAWN,
+  IEXEC_SYSCOUNT_WAIT,
+  IEXEC_SYSCOUNT_PHASES
+} iexec_syscount_phase_t;
+
+typedef struct iexec_syscount_proc {
+  pid_t pid;
+  iexec_syscount_phase_t phase;
+  int started;
+} iexec_syscount_proc_t;
+
+static const char *const iexec_syscount_phase_names[] = {"startup", "spawn",
+                                                         "wait"};
+static iexec_syscount_proc_t iexec_syscount_procs[IEXEC_SYSCOUNT_MAX_PROCS];
+static unsigned long iexec_syscount_counts[IEXEC_SYSCOUNT_PHASES]
+                                          [IEXEC_SYSCOUNT_MAX_NR];
+static unsigned long iexec_syscount_spawns = 0;
+
+#ifdef PTRACE_GET_SYSCALL_INFO
+
+static iexec_syscount_proc_t *iexec_syscount_find(pid_t pid) {
+  for (int i = 0; i < IEXEC_SYSCOUNT_MAX_PROCS; i++) {
+    if (iexec_syscount_procs[i].pid == pid) {
+      return &iexec_syscount_procs[i];
+    }
+  }
+  return NULL;
+}
+
+static iexec_syscount_proc_t *iexec_syscount_add(pid_t pid,
+                                                 iexec_syscount_phase_t phase) {
+  iexec_syscount_proc_t *proc = iexec_syscount_find(0);
+  if (proc == NULL) {
+    fprintf(stderr, "iexec-syscount: too many traced processes\n");
+    exit(EXIT_FAILURE);
+  }
+  proc->pid = pid;
+  proc->phase = phase;
+  proc->started = 1;
+  return proc;
+}
+
+static void iexec_syscount_count(pid_t pid, iexec_syscount_proc_t *proc) {
+  struct __ptrace_syscall_info info;
+  memset(&info, 0, sizeof(info));
+  if (ptrace(PTRACE_GET_SYSCALL_INFO, pid, (void *)sizeof(info), &info) ==
+      -1) {
+    fprintf(stderr, "iexec-syscount: PTRACE_GET_SYSCALL_INFO: %s\n",
+            strerror(errno));
+    kill(pid, SIGKILL);
+    exit(IEXEC_SYSCOUNT_SKIP);
+  }
+  if (info.op != PTRACE_SYSCALL_INFO_ENTRY || !proc->started) {
+    return;
+  }
+  uint64_t nr = info.entry.nr;
+  if (nr >= IEXEC_SYSCOUNT_MAX_NR) {
+    nr = IEXEC_SYSCOUNT_MAX_NR - 1;
+  }
+  iexec_syscount_counts[proc->phase][nr]++;
+}
+
+static int iexec_syscount_trace(pid_t root) {
+  int status;
+  int root_status = EXIT_FAILURE;
+
+  if (waitpid(root, &status, 0) == -1 || !WIFSTOPPED(status)) {
+    // the child could not make itself traceable
+    return IEXEC_SYSCOUNT_SKIP;
+  }
+  long options = PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEFORK |
+                 PTRACE_O_TRACEVFORK | PTRACE_O_TRACECLONE |
+                 PTRACE_O_TRACEEXEC | PTRACE_O_EXITKILL;
+  if (ptrace(PTRACE_SETOPTIONS, root, NULL, (void *)options) == -1) {
+    fprintf(stderr, "iexec-syscount: PTRACE_SETOPTIONS: %s\n", strerror(errno));
+    kill(root, SIGKILL);
+    return IEXEC_SYSCOUNT_SKIP;
+  }
+  // the exec of iexec itself is not counted
+  iexec_syscount_add(root, IEXEC_SYSCOUNT_STARTUP)->started = 0;
+  ptrace(PTRACE_SYSCALL, root, NULL, NULL);
+
+  while (1) {
+    pid_t pid = waitpid(-1, &status, __WALL);
+    if (pid == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    iexec_syscount_proc_t *proc = iexec_syscount_find(pid);
+    if (WIFEXITED(status) || WIFSIGNALED(status)) {
+      if (pid == root) {
+        root_status = WIFEXITED(status) ? WEXITSTATUS(status)
+                                        : 128 + WTERMSIG(status);
+      }
+      if (proc != NULL) {
+        proc->pid = 0;
+      }
+      continue;
+    }
+    if (!WIFSTOPPED(status)) {
+      continue;
+    }
+    if (proc == NULL) {
+      // a new child may stop before its parent reports the fork event
+      proc = iexec_syscount_add(pid, IEXEC_SYSCOUNT_SPAWN);
+    }
+
+    int sig = WSTOPSIG(status);
+    int event = status >> 16;
+    int inject = 0;
+    if (sig == (SIGTRAP | 0x80)) {
+      iexec_syscount_count(pid, proc);
+    } else if (event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK ||
+               event == PTRACE_EVENT_CLONE) {
+      unsigned long child;
+      ptrace(PTRACE_GETEVENTMSG, pid, NULL, &child);
+      if (iexec_syscount_find((pid_t)child) == NULL) {
+        iexec_syscount_add((pid_t)child, IEXEC_SYSCOUNT_SPAWN);
+      }
+      if (proc->phase == IEXEC_SYSCOUNT_STARTUP) {
+        proc->phase = IEXEC_SYSCOUNT_WAIT;
+      }
+      iexec_syscount_spawns++;
+    } else if (event == PTRACE_EVENT_EXEC) {
+      if (!proc->started) {
+        proc->started = 1;
+      } else if (proc->phase == IEXEC_SYSCOUNT_SPAWN) {
+        // the command runs untraced from here on
+        ptrace(PTRACE_DETACH, pid, NULL, NULL);
+        proc->pid = 0;
+        continue;
+      }
+    } else if (sig != SIGSTOP && sig != SIGTRAP) {
+      inject = sig;
+    }
+    ptrace(PTRACE_SYSCALL, pid, NULL, (void *)(long)inject);
+  }
+  return root_status;
+}
+
+int main(int argc, char **argv) {
+  int verbose = 0;
+  int argi = 1;
+  if (argi < argc && strcmp(argv[argi], "-v") == 0) {
+    verbose = 1;
+    argi++;
+  }
+  if (argi == argc) {
+    fprintf(stderr, "Usage: %s [-v] IEXEC [ARG]...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  pid_t root = fork();
+  if (root == -1) {
+    perror("fork");
+    return EXIT_FAILURE;
+  }
+  if (root == 0) {
+    if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) == -1) {
+      fprintf(stderr, "iexec-syscount: PTRACE_TRACEME: %s\n", strerror(errno));
+      _exit(IEXEC_SYSCOUNT_SKIP);
+    }
+    raise(SIGSTOP);
+    execvp(argv[argi], argv + argi);
+    perror(argv[argi]);
+    _exit(127);
+  }
+
+  int status = iexec_syscount_trace(root);
+  for (int phase = 0; phase < IEXEC_SYSCOUNT_PHASES; phase++) {
+    unsigned long total = 0;
+    for (int nr = 0; nr < IEXEC_SYSCOUNT_MAX_NR; nr++) {
+      total += iexec_syscount_counts[phase][nr];
+      if (verbose && iexec_syscount_counts[phase][nr] != 0) {
+        fprintf(stderr, "%s %d %lu\n", iexec_syscount_phase_names[phase], nr,
+                iexec_syscount_counts[phase][nr]);
+      }
+    }
+    printf("%s %lu\n", iexec_syscount_phase_names[phase], total);
+  }
+  printf("spawns %lu\n", iexec_syscount_spawns);
+  return status;
+}
+
+#else
+
+int main(void) {
+  fprintf(stderr, "iexec-syscount: PTRACE_GET_SYSCALL_INFO is not available\n");
+  return IEXEC_SYSCOUNT_SKIP;
+}
+
+#endif
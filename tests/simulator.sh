@@ -0,0 +1,10 @@
+#!/bin/sh
+
+set -u
+
+SIM=${IEXEC_SIM_BINARY:-./tests/iexec-sim}
+SCENARIOS=${IEXEC_SIM_SCENARIOS:-200000}
+SEED=${IEXEC_SIM_SEED:-1}
+
+# the simulator replays and traces the first failing scenario by itself
+exec "$SIM" -n "$SCENARIOS" -s "$SEED"
@@ -0,0 +1,65 @@
+#!/bin/sh
+
+set -u
+
+IEXEC=${IEXEC_TEST_BINARY:-./src/iexec}
+SYSCOUNT=${IEXEC_SYSCOUNT_BINARY:-./tests/iexec-syscount}
+BUDGET=${IEXEC_SYSCALL_BUDGET:-./tests/syscall-budget.txt}
+
+fail() {
+  echo "FAIL: $*" >&2
+  exit 1
+}
+
+tmpdir=$(mktemp -d "${TMPDIR:-/tmp}/iexec-syscall-test.XXXXXX") || exit 99
+
+cleanup() {
+  rm -rf "$tmpdir"
+}
+
+trap cleanup EXIT HUP INT TERM
+
+over_budget=0
+
+# run one scenario and compare every phase with its budget
+scenario() {
+  name=$1
+  shift
+
+  "$SYSCOUNT" -v "$IEXEC" "$@" >"$tmpdir/$name.out" 2>"$tmpdir/$name.err"
+  status=$?
+  if [ "$status" -eq 77 ]; then
+    echo "SKIP: ptrace is not available: $(cat "$tmpdir/$name.err")"
+    exit 77
+  fi
+  if [ "$status" -ne 0 ]; then
+    fail "scenario $name exited with status $status"
+  fi
+  while read -r phase count; do
+    budget=$(awk -v s="$name" -v p="$phase" \
+      '$1 == s && $2 == p { print $3 }' "$BUDGET")
+    if [ -z "$budget" ]; then
+      fail "no budget for $name $phase"
+    fi
+    if [ "$count" -gt "$budget" ]; then
+      echo "FAIL: $name $phase: $count system calls, budget $budget" >&2
+      echo "  system call number and count:" >&2
+      awk -v p="$phase" '$1 == p { print "  " $2 " " $3 }' \
+        "$tmpdir/$name.err" >&2
+      over_budget=1
+    else
+      echo "$name $phase: $count (budget $budget)"
+    fi
+  done <"$tmpdir/$name.out"
+}
+
+scenario true /bin/true
+scenario env FOO=bar BAR=baz /bin/true
+# a sleeping child must not cost more than an exiting one: no idle wakeups
+scenario idle /bin/sleep 2
+scenario orphans /bin/sh -c '(sleep 0.2 &); (sleep 0.3 &); (sleep 0.4 &); exit 0'
+scenario journal --journal="$tmpdir/journal" /bin/true
+
+if [ "$over_budget" -ne 0 ]; then
+  fail "system call budget exceeded; see docs/syscall-budget.md"
+fi